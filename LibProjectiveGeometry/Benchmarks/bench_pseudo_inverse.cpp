@@ -0,0 +1,129 @@
+// Microbenchmark of the pseudo-inverse and null-space of 3x4 projection matrices.
+// Compares the dynamically sized SVD that was used before, the fixed-size SVD (rank deficient fallback)
+// and the closed form of pseudoInverseAndNullspace. Build with -DLIBPROJECTIVEGEOMETRY_BENCHMARKS=ON.
+
+#include "ProjectionMatrix.h"
+#include "SingularValueDecomposition.h"
+#include "SourceDetectorGeometry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace Eigen;
+using namespace Geometry;
+
+namespace
+{
+	/// The former implementation of pseudoInverseAndNullspace: a dynamically sized SVD, allocates per call
+	void pseudoInverseAndNullspaceDynamicSVD(const Matrix<double,3,4>& P, Matrix<double,4,3>& Pinv, Vector4d& C)
+	{
+		JacobiSVD<MatrixXd> svd(P, ComputeFullU | ComputeFullV);
+		double  tolerance=1e-6;
+		int u=(int)P.rows(), v=(int)P.cols(), n=std::min<int>(u,v);
+		MatrixXd sigma(v,u);
+		sigma.setZero();
+		sigma.topLeftCorner(n,n)=svd.singularValues().asDiagonal();
+		for (int i=0;i<n;i++)
+			if (sigma(i,i)<tolerance) sigma(i,i)=0;
+			else sigma(i,i)=1.0/sigma(i,i);
+		Pinv=svd.matrixV()*sigma*svd.matrixU().transpose();
+		auto V=svd.matrixV();
+		C=V.col(V.cols()-1);
+	}
+
+	/// The fallback of pseudoInverseAndNullspace for rank deficient matrices: a fixed-size SVD
+	void pseudoInverseAndNullspaceFixedSVD(const Matrix<double,3,4>& P, Matrix<double,4,3>& Pinv, Vector4d& C)
+	{
+		double  tolerance=1e-6;
+		JacobiSVD<Matrix<double,3,4> > svd(P, ComputeFullU | ComputeFullV);
+		Matrix<double,4,3> sigma=Matrix<double,4,3>::Zero();
+		for (int i=0;i<3;i++)
+			if (svd.singularValues()(i)>=tolerance) sigma(i,i)=1.0/svd.singularValues()(i);
+		Pinv=svd.matrixV()*sigma*svd.matrixU().transpose();
+		C=svd.matrixV().col(3);
+	}
+
+	/// Best of several runs, in calls per second
+	template <typename Function>
+	double callsPerSecond(const char* name, Function function)
+	{
+		const int calls=200000;
+		double best=0;
+		volatile double sink=0;
+		for (int run=0;run<5;run++)
+		{
+			auto start=std::chrono::steady_clock::now();
+			for (int i=0;i<calls;i++)
+				sink=sink+function(i);
+			double seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+			best=std::max(best,calls/seconds);
+		}
+		printf("%-40s %12.0f calls/s\n",name,best);
+		return best;
+	}
+
+	/// Calibrated C-arm like matrices: focal length 4000 px, 750 mm to the isocenter, random orientation
+	std::vector<ProjectionMatrix> randomProjectionMatrices(int count)
+	{
+		std::mt19937 random(1);
+		std::uniform_real_distribution<double> uniform(-1,1);
+		std::vector<ProjectionMatrix> matrices(count);
+		for (auto& P : matrices)
+		{
+			Matrix3d K;
+			K << 4000,0,620, 0,4000,480, 0,0,1;
+			Matrix3d R=Quaterniond(Vector4d(uniform(random),uniform(random),uniform(random),uniform(random)).normalized()).toRotationMatrix();
+			Vector3d t(uniform(random)*50,uniform(random)*50,750+uniform(random)*10);
+			P << K*R, K*t;
+		}
+		return matrices;
+	}
+
+	/// Largest relative difference of the pseudo-inverse and null-space (up to sign) to the dynamic SVD
+	void printAccuracy(const std::vector<ProjectionMatrix>& matrices)
+	{
+		double maxPinv=0, maxC=0;
+		for (const auto& P : matrices)
+		{
+			Matrix<double,4,3> reference, Pinv;
+			Vector4d referenceC, C;
+			pseudoInverseAndNullspaceDynamicSVD(P,reference,referenceC);
+			pseudoInverseAndNullspace(P,Pinv,C);
+			maxPinv=std::max(maxPinv,(Pinv-reference).norm()/reference.norm());
+			maxC=std::max(maxC,std::min((C-referenceC).norm(),(C+referenceC).norm()));
+		}
+		printf("max. relative difference of P^+ %.2e, of the null-space %.2e (%d matrices)\n",maxPinv,maxC,(int)matrices.size());
+	}
+} // namespace
+
+int main()
+{
+	auto matrices=randomProjectionMatrices(64);
+	printAccuracy(randomProjectionMatrices(10000));
+
+	callsPerSecond("pseudoInverseAndNullspace (dynamic SVD)",[&](int i) {
+		Matrix<double,4,3> Pinv; Vector4d C;
+		pseudoInverseAndNullspaceDynamicSVD(matrices[i&63],Pinv,C);
+		return Pinv(0,0)+C(0);
+	});
+	callsPerSecond("pseudoInverseAndNullspace (fixed SVD)",[&](int i) {
+		Matrix<double,4,3> Pinv; Vector4d C;
+		pseudoInverseAndNullspaceFixedSVD(matrices[i&63],Pinv,C);
+		return Pinv(0,0)+C(0);
+	});
+	callsPerSecond("pseudoInverseAndNullspace",[&](int i) {
+		Matrix<double,4,3> Pinv; Vector4d C;
+		pseudoInverseAndNullspace(matrices[i&63],Pinv,C);
+		return Pinv(0,0)+C(0);
+	});
+	callsPerSecond("pseudoInverse(P)",[&](int i) { return pseudoInverse(matrices[i&63])(1,1); });
+	callsPerSecond("getCameraCenter(P)",[&](int i) { return getCameraCenter(matrices[i&63])(0); });
+	callsPerSecond("SourceDetectorGeometry(P)",[&](int i) {
+		SourceDetectorGeometry geometry(matrices[i&63],0.308);
+		return geometry.C(0);
+	});
+	return 0;
+}
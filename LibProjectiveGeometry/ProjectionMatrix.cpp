@@ -20,7 +20,10 @@ namespace Geometry
 	/// Backprojection
 	ProjectionMatrixInverse pseudoInverse(const ProjectionMatrix& P)
 	{
-		return pseudoInverse(Eigen::MatrixXd(P));
+		ProjectionMatrixInverse Pinv;
+		Eigen::Vector4d C;
+		pseudoInverseAndNullspace(P,Pinv,C);
+		return Pinv;
 	}
 
 	/// Decompose Projection Matrix into K[R|t] using RQ-decomposition. Returns false if R is left-handed (For RHS world coordinate systems, this implies imageVPointsUp is wrong).
@@ -66,10 +69,10 @@ namespace Geometry
 		return K;
 	}
 
-	/// Extract the world coordinates of the camera center from a projection matrix. (SVD based implementation)
+	/// Extract the world coordinates of the camera center from a projection matrix. (Closed form, SVD for rank deficient P)
 	RP3Point getCameraCenter(const ProjectionMatrix& P)
 	{
-		Eigen::Vector4d C=nullspace(P);
+		Eigen::Vector4d C=nullspace3x4(P);
 		if (C(3)<-1e-12 || C(3)>1e-12)
 			C=C/C(3); // Def:Camera centers are always positive.
 		return C;
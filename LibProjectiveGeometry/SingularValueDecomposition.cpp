@@ -1,5 +1,8 @@
 
 #include <Eigen/SVD>
+#include <Eigen/LU>
+
+#include <cmath>
 
 using namespace Eigen;
 	
@@ -22,21 +25,55 @@ namespace Geometry
 		return pinv;
 	}
 
+	/// Signed 3x3 minors of a 3x4 matrix, which span its null-space if it has full rank. Returns false if the smallest
+	/// singular value may be below tolerance. The sum of the squared minors is det(P*P') (Cauchy-Binet) and the product of
+	/// the two largest squared singular values is at most trace(P*P')^2.
+	static bool nullspaceFromMinors(const Eigen::Matrix<double,3,4>& P, double tolerance, Eigen::Vector4d& C)
+	{
+		for (int i=0;i<4;i++)
+		{
+			Matrix3d M;
+			for (int j=0,k=0;j<4;j++)
+				if (j!=i) M.col(k++)=P.col(j);
+			C(i)=(i%2?-1.0:1.0)*M.determinant();
+		}
+		double det=C.squaredNorm();
+		double trace=P.squaredNorm();
+		if (det<tolerance*tolerance*trace*trace)
+			return false;
+		C/=std::sqrt(det);
+		return true;
+	}
+
 	/// Compute the pseudo-inverse and null-space of a matrix
 	void pseudoInverseAndNullspace(const Eigen::Matrix<double,3,4>& P, Eigen::Matrix<double,4,3>& Pinv, Eigen::Vector4d& C)
 	{
-		JacobiSVD<MatrixXd> svd(P, ComputeFullU | ComputeFullV);
 		double  tolerance=1e-6;
-		int u=(int)P.rows(), v=(int)P.cols(), n=std::min<int>(u,v);
-		MatrixXd sigma(v,u);
-		sigma.setZero();
-		sigma.topLeftCorner(n,n)=svd.singularValues().asDiagonal();
-		for (int i=0;i<n;i++)
-			if (sigma(i,i)<tolerance) sigma(i,i)=0;
-			else sigma(i,i)=1.0/sigma(i,i);
+		// Full rank: [P;C'] is invertible and, because of P*C=0, its inverse is [Pinv C]
+		if (nullspaceFromMinors(P,tolerance,C))
+		{
+			Matrix4d A;
+			A << P, C.transpose();
+			Pinv=A.inverse().leftCols<3>();
+			return;
+		}
+		// Fixed-size SVD, does not allocate either
+		JacobiSVD<Matrix<double,3,4> > svd(P, ComputeFullU | ComputeFullV);
+		Matrix<double,4,3> sigma=Matrix<double,4,3>::Zero();
+		for (int i=0;i<3;i++)
+			if (svd.singularValues()(i)>=tolerance) sigma(i,i)=1.0/svd.singularValues()(i);
 		Pinv=svd.matrixV()*sigma*svd.matrixU().transpose();
-		auto V=svd.matrixV();
-		C=V.col(V.cols()-1);
+		C=svd.matrixV().col(3);
+	}
+
+	/// Compute right null-space of a 3x4 matrix
+	Eigen::Vector4d nullspace3x4(const Eigen::Matrix<double,3,4>& P)
+	{
+		Eigen::Vector4d C;
+		if (nullspaceFromMinors(P,1e-6,C))
+			return C;
+		JacobiSVD<Matrix<double,3,4> > svd(P, ComputeFullV);
+		return svd.matrixV().col(3);
 	}
 
 	/// Compute right null-space of A
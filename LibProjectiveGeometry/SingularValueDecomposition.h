@@ -10,9 +10,12 @@ namespace Geometry
 	/// Compute the pseudo-inverse of a matrix
 	Eigen::MatrixXd pseudoInverse(const Eigen::MatrixXd& A);
 
-	/// Compute the pseudo-inverse and null-space of a matrix
+	/// Compute the pseudo-inverse and null-space of a 3x4 matrix. Closed form for full rank, no heap allocations.
 	void pseudoInverseAndNullspace(const Eigen::Matrix<double,3,4>& P, Eigen::Matrix<double,4,3>& Pinv, Eigen::Vector4d& C);
 
+	/// Compute right null-space of a 3x4 matrix. Closed form for full rank, no heap allocations.
+	Eigen::Vector4d nullspace3x4(const Eigen::Matrix<double,3,4>& P);
+
 	/// Compute right null-space of A
 	Eigen::VectorXd nullspace(const Eigen::MatrixXd& A);
 
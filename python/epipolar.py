@@ -8,6 +8,7 @@
 
 """
 
+import io
 import os
 import random
 from os.path import join
@@ -23,10 +24,18 @@ import sympy
 projection_global = {}
 
 
-def read_volumes(dirname):
+def read_volumes(dirname, skip_files=(), random_if_empty=True):
+    """
+    skip_files: files that were already read by the native loader (absolute paths)
+    random_if_empty: return random volumes if no volume could be read
+    """
     volumes = []
+    skip_files = set(skip_files)
     try:
         for root, dirs, files in os.walk(dirname):
+            files = [f for f in files if os.path.abspath(join(root, f)) not in skip_files]
+            if not files:
+                continue
             try:
                 import pyconrad.dicom_utils
                 vol, _, _, _ = pyconrad.dicom_utils.dicomdir2vol(root)
@@ -34,13 +43,6 @@ def read_volumes(dirname):
                     volumes.append(vol)
             except Exception as e:
                 print(e)
-
-            try:
-                vol, _, _, _ = pyconrad.dicom_utils.dicomdir2vol(root)
-                if vol is not None and vol.ndim == 3:
-                    volumes.append(vol)
-            except Exception as e:
-                print(e)
             for f in [f for f in files if f.endswith('.vdb')]:
                 try:
                     import volume2mesh
@@ -76,7 +78,7 @@ def read_volumes(dirname):
 
     except Exception as e:
         print(e)
-    if not volumes:
+    if not volumes and random_if_empty:
         for i in range(4):
             volumes.append(np.random.randn(100, 100, 100))
 
@@ -86,57 +88,93 @@ def read_volumes(dirname):
     # return volumes
 
 
-# def read_projections(dirname):
-    # projections = []
-    # matrices = []
-    # for i in range(4):
-    # sub_projections = []
-    # sub_matrices = []
-    # for i in range(3):
-    # sub_projections.append(np.random.randn(100, 100))
-
-    # sub_projections.append(sub_projections)
-    # sub_matrices.append(sub_matrices)
-    # return projections, matrices
-
-def read_projections(dirname):
-    projections = [[]]
+def read_projection(dicom_file):
+    """
+    Decodes the projection of a DICOM file, normalized to a maximum of 1
+    """
+    dc = np.array(pydicom.read_file(dicom_file).pixel_array)
+    if dc is not None:
+        if len(dc) > 1:
+            dc = dc[2]
+        else:
+            dc = dc[0]
+    dc = dc.astype(np.float32)
+    dc /= np.max(dc)
+    return dc
+
+
+def decode_projection(data):
+    """
+    Like read_projection, but decodes the bytes of a DICOM file that the native importer already read
+    """
+    return read_projection(io.BytesIO(data))
+
+
+def index_projections(dirname):
+    """
+    Like read_projections, but without decoding: returns the DICOM file of each projection and
+    the matrices of each pumpkin as one float64 array (N x 3 x 4)
+    """
+    files = [[]]
     matrices = [[]]
 
     current_pumkin = 0
     try:
-        for root, dirs, files in os.walk(dirname):
+        for root, dirs, dir_files in os.walk(dirname):
             print(f'Discovering {root}')
             if not dirs:
                 print(f'Found folder with proj matrix {root}')
-                assert 'pmat_3x4.txt' in files
+                assert 'pmat_3x4.txt' in dir_files
                 csv_file = join(root, 'pmat_3x4.txt')
                 mat = np.array(pandas.read_csv(csv_file, sep=' ', header=None))
-                dicom = [f for f in files if f.endswith('.IMA')][0]
-                dc = np.array(pydicom.read_file(join(root, dicom)).pixel_array)
-                if dc is not None:
-                    if len(dc) > 1:
-                        dc = dc[2]
-                    else:
-                        dc = dc[0]
-                dc = dc.astype(np.float32)
-                dc /= np.max(dc)
-                projections[current_pumkin].append(dc)
-                mat = mat.astype(np.float32)
-                # print(mat.shape)
-                matrices[current_pumkin].append(mat)
-            elif projections[current_pumkin]:
+                dicom = [f for f in dir_files if f.endswith('.IMA')][0]
+                files[current_pumkin].append(join(root, dicom))
+                matrices[current_pumkin].append(mat.astype(np.float32))
+            elif files[current_pumkin]:
                 print(f'New pumkin {root}')
                 current_pumkin += 1
-                projections.append([])
+                files.append([])
                 matrices.append([])
     except Exception as e:
         print(e)
 
+    files = [f for f in files if f]
+    matrices = [np.ascontiguousarray(np.stack(m), dtype=np.float64) for m in matrices if m]
+    assert len(matrices) == len(files)
+    return files, matrices
+
+
+def read_projections(dirname):
+    files, stacked_matrices = index_projections(dirname)
+    projections = []
+    matrices = []
+    for pumpkin_files, pumpkin_matrices in zip(files, stacked_matrices):
+        projections.append([])
+        matrices.append([])
+        for f, mat in zip(pumpkin_files, pumpkin_matrices):
+            try:
+                projections[-1].append(read_projection(f))
+                matrices[-1].append(mat.astype(np.float32))
+            except Exception as e:
+                print(e)
+
     projections = [p for p in projections if p]
     matrices = [m for m in matrices if m]
     assert len(matrices) == len(projections)
+    return projections, matrices
+
 
+def read_projections_stacked(dirname):
+    """
+    Like read_projections, but one C-contiguous array per pumpkin:
+    float32 projections (N x H x W) and float64 matrices (N x 3 x 4)
+    """
+    projections, matrices = read_projections(dirname)
+    for p in projections:
+        if len({proj.shape for proj in p}) != 1:
+            raise ValueError(f'Projections of a pumpkin have different shapes: {sorted({proj.shape for proj in p})}')
+    projections = [np.ascontiguousarray(np.stack(p), dtype=np.float32) for p in projections]
+    matrices = [np.ascontiguousarray(np.stack(m), dtype=np.float64) for m in matrices]
     return projections, matrices
 
 
@@ -0,0 +1,57 @@
+/*
+ * BrickedVolume.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "BrickedVolume.hpp"
+
+BrickedVolume::BrickedVolume(const VolumeView& volume) : m_size(volume.size), m_spacing(volume.spacing)
+{
+    std::array< int64_t, 3 > bricks{};
+    for (int a = 0; a < 3; ++a)
+    {
+        bricks[a] = (m_size[a] + BRICK_SIZE - 1) >> BRICK_BITS;
+    }
+    // Elements of one brick (within) and one step of the brick index (across) per axis
+    std::array< int64_t, 3 > within{ BRICK_SIZE * BRICK_SIZE, BRICK_SIZE, 1 };
+    std::array< int64_t, 3 > across{ bricks[1] * bricks[2], bricks[2], 1 };
+    for (int a = 0; a < 3; ++a)
+    {
+        m_offsets[a].resize(static_cast< size_t >(m_size[a]));
+        for (int64_t i = 0; i < m_size[a]; ++i)
+        {
+            m_offsets[a][i] = (i >> BRICK_BITS) * across[a] * BRICK_SIZE * BRICK_SIZE * BRICK_SIZE +
+                              (i & (BRICK_SIZE - 1)) * within[a];
+        }
+    }
+
+    m_data.assign(static_cast< size_t >(bricks[0] * bricks[1] * bricks[2] * BRICK_SIZE * BRICK_SIZE * BRICK_SIZE),
+                  0.f);
+#pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < m_size[0]; ++i)
+    {
+        for (int64_t j = 0; j < m_size[1]; ++j)
+        {
+            float* row = m_data.data() + m_offsets[0][i] + m_offsets[1][j];
+            for (int64_t k = 0; k < m_size[2]; ++k)
+            {
+                row[m_offsets[2][k]] = volume.at(i, j, k);
+            }
+        }
+    }
+}
+
+auto BrickedVolume::view() const -> VolumeView
+{
+    VolumeView view;
+    view.data    = m_data.data();
+    view.size    = m_size;
+    view.spacing = m_spacing;
+    for (int a = 0; a < 3; ++a)
+    {
+        view.offsets[a] = m_offsets[a].data();
+    }
+    return view;
+}
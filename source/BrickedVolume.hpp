@@ -0,0 +1,42 @@
+/*
+ * BrickedVolume.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "ForwardProjector.hpp"
+
+enum class VolumeLayout { Linear, Bricked };
+
+// Copy of a volume in bricks of 8x8x8 voxels (2 KiB each). Neighboring voxels along all three axes mostly share a
+// brick, so oblique rays touch far fewer cache lines and pages than in C order. Bricks at the upper borders are
+// zero-padded.
+//
+// The brick-local address is separable: voxel (i, j, k) is stored at offset[0][i] + offset[1][j] + offset[2][k].
+class BrickedVolume
+{
+  public:
+    static constexpr int64_t BRICK_BITS = 3;
+    static constexpr int64_t BRICK_SIZE = int64_t(1) << BRICK_BITS;
+
+    BrickedVolume() = default;
+    explicit BrickedVolume(const VolumeView& volume);
+
+    // View for `forwardProject`, only valid as long as this object exists and is not moved
+    [[nodiscard]] auto view() const -> VolumeView;
+    [[nodiscard]] auto size() const -> const std::array< int64_t, 3 >& { return m_size; }
+    [[nodiscard]] auto bytes() const -> size_t { return m_data.size() * sizeof(float); }
+
+  private:
+    std::vector< float > m_data;
+    std::array< std::vector< int64_t >, 3 > m_offsets;
+    std::array< int64_t, 3 > m_size{};
+    double m_spacing = 1.;
+};
@@ -0,0 +1,102 @@
+/*
+ * CompactVolume.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "CompactVolume.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "ProjectionCache.hpp"
+
+namespace
+{
+constexpr double UINT16_LEVELS = 65535.;
+} // namespace
+
+CompactVolume::CompactVolume(const VolumeView& volume, SampleFormat format)
+    : m_size(volume.size), m_spacing(volume.spacing), m_format(format)
+{
+    if (format == SampleFormat::Float32)
+    {
+        throw std::runtime_error("Compact volumes need a 16 bit sample format");
+    }
+
+    if (format == SampleFormat::UInt16)
+    {
+        auto minimum = std::numeric_limits< float >::max();
+        auto maximum = std::numeric_limits< float >::lowest();
+#pragma omp parallel for schedule(static) reduction(min : minimum) reduction(max : maximum)
+        for (int64_t i = 0; i < m_size[0]; ++i)
+        {
+            for (int64_t j = 0; j < m_size[1]; ++j)
+            {
+                for (int64_t k = 0; k < m_size[2]; ++k)
+                {
+                    minimum = std::min(minimum, volume.at(i, j, k));
+                    maximum = std::max(maximum, volume.at(i, j, k));
+                }
+            }
+        }
+        m_bias  = minimum;
+        m_scale = maximum > minimum ? static_cast< float >((maximum - minimum) / UINT16_LEVELS) : 1.f;
+    }
+
+    m_samples.assign(static_cast< size_t >(m_size[0] * m_size[1] * m_size[2]) + 1, 0);
+#pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < m_size[0]; ++i)
+    {
+        for (int64_t j = 0; j < m_size[1]; ++j)
+        {
+            uint16_t* row = m_samples.data() + (i * m_size[1] + j) * m_size[2];
+            for (int64_t k = 0; k < m_size[2]; ++k)
+            {
+                if (format == SampleFormat::UInt16)
+                {
+                    auto level = std::lround((volume.at(i, j, k) - m_bias) / m_scale);
+                    row[k]     = static_cast< uint16_t >(std::clamp(level, 0L, 65535L));
+                }
+                else
+                {
+                    row[k] = floatToHalf(volume.at(i, j, k));
+                }
+            }
+        }
+    }
+
+    // Projections of the dequantized samples differ from the ones of the original volume
+    m_hash = contentHash(view());
+}
+
+CompactVolume::CompactVolume(std::shared_ptr< const void > owner, const VolumeView& volume)
+    : m_owner(std::move(owner)), m_borrowed(volume.samples), m_size(volume.size), m_spacing(volume.spacing),
+      m_format(volume.format), m_scale(volume.scale), m_bias(volume.bias), m_hash(volume.id)
+{
+    if (m_format == SampleFormat::Float32 || !volume.linear())
+    {
+        throw std::runtime_error("Compact volumes need linear 16 bit samples");
+    }
+    if (!m_hash)
+    {
+        m_hash = contentHash(view());
+    }
+}
+
+auto CompactVolume::view() const -> VolumeView
+{
+    VolumeView view;
+    view.format  = m_format;
+    view.samples = m_owner ? m_borrowed : m_samples.data();
+    view.scale   = m_scale;
+    view.bias    = m_bias;
+    view.size    = m_size;
+    view.stride  = { m_size[1] * m_size[2], m_size[2], 1 };
+    view.spacing = m_spacing;
+    view.id      = m_hash;
+    return view;
+}
@@ -0,0 +1,51 @@
+/*
+ * CompactVolume.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ForwardProjector.hpp"
+#include "SampleFormat.hpp"
+
+// Linear (C order) copy of a volume with 16 bit samples, half the memory of float samples. The projectors dequantize
+// each sample when it is read:
+//
+//   UInt16   `scale * sample + bias`, quantized linearly between the minimum and maximum of the volume. The error is at
+//            most (maximum - minimum) / 131070.
+//   Float16  IEEE half precision, relative error at most 2^-11. Values beyond +-65504 are clamped.
+class CompactVolume
+{
+  public:
+    CompactVolume() = default;
+    // `format` must not be Float32
+    CompactVolume(const VolumeView& volume, SampleFormat format);
+    // Uses the 16 bit samples of `volume` in place (linear, with padding), e.g. of a MappedVolume kept alive by `owner`
+    CompactVolume(std::shared_ptr< const void > owner, const VolumeView& volume);
+
+    // View for `forwardProject` with the `contentHash` of the dequantized samples as id, only valid as long as this
+    // object exists and is not moved
+    [[nodiscard]] auto view() const -> VolumeView;
+    [[nodiscard]] auto format() const -> SampleFormat { return m_format; }
+    // Resident memory of the samples, 0 if they are borrowed
+    [[nodiscard]] auto bytes() const -> size_t { return m_samples.size() * sizeof(uint16_t); }
+    [[nodiscard]] auto borrowed() const -> bool { return m_owner != nullptr; }
+
+  private:
+    std::vector< uint16_t > m_samples; // followed by one sample of padding for 32 bit gathers
+    std::shared_ptr< const void > m_owner;
+    const uint16_t* m_borrowed = nullptr;
+    std::array< int64_t, 3 > m_size{};
+    double m_spacing      = 1.;
+    SampleFormat m_format = SampleFormat::UInt16;
+    float m_scale         = 1.f;
+    float m_bias          = 0.f;
+    uint64_t m_hash       = 0;
+};
@@ -0,0 +1,67 @@
+/*
+ * ConeBeamGeometry.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "ConeBeamGeometry.hpp"
+
+#include <cmath>
+
+static constexpr double TWO_PI = 2. * M_PI;
+
+auto ConeBeamGeometry::projectionMatrix(const Geometry::RP3Homography& rotation) const -> Geometry::ProjectionMatrix
+{
+    auto focalLength = sourceDetectorDistance / detectorSpacing;
+    // Principal point in the detector center, pixel centers at integer coordinates
+    auto K = Geometry::makeCalibrationMatrix(focalLength, focalLength, 0.5 * (detectorWidth - 1),
+                                             0.5 * (detectorHeight - 1));
+    // Source at (0, 0, -sourceIsocenterDistance) looking at the isocenter
+    Geometry::ProjectionMatrix P = Geometry::makeProjectionMatrix(K, Eigen::Matrix3d::Identity(),
+                                                                  Eigen::Vector3d(0., 0., sourceIsocenterDistance));
+    P = P * rotation;
+    Geometry::normalizeProjectionMatrix(P);
+    return P;
+}
+
+auto ConeBeamGeometry::randomProjectionMatrix(std::mt19937& random) const -> Geometry::ProjectionMatrix
+{
+    std::uniform_real_distribution<> dis(0., TWO_PI);
+    Geometry::RP3Homography rotation =
+        Geometry::RotationX(dis(random)) * Geometry::RotationY(dis(random)) * Geometry::RotationZ(dis(random));
+    return projectionMatrix(rotation);
+}
+
+auto ConeBeamGeometry::downscaled(int factor) const -> ConeBeamGeometry
+{
+    ConeBeamGeometry geometry = *this;
+    geometry.detectorWidth    = (detectorWidth + factor - 1) / factor;
+    geometry.detectorHeight   = (detectorHeight + factor - 1) / factor;
+    geometry.detectorSpacing  = detectorSpacing * factor;
+    return geometry;
+}
+
+auto downscaleProjectionMatrix(const Geometry::ProjectionMatrix& P, int factor) -> Geometry::ProjectionMatrix
+{
+    // x_coarse = (x - (factor - 1) / 2) / factor
+    double offset = -0.5 * (factor - 1) / factor;
+    Eigen::Matrix3d S;
+    S << 1. / factor, 0., offset, //
+        0., 1. / factor, offset,  //
+        0., 0., 1.;
+    return S * P;
+}
+
+auto toProjectionKernelConvention(const Geometry::ProjectionMatrix& P, int detectorWidth, int detectorHeight,
+                                  double detectorSpacing) -> Geometry::ProjectionMatrix
+{
+    // u_row = (y + 0.5 - height / 2) * spacing, u_col = (x + 0.5 - width / 2) * spacing
+    Eigen::Matrix3d A;
+    A << 0., detectorSpacing, detectorSpacing * (0.5 - 0.5 * detectorHeight), //
+        detectorSpacing, 0., detectorSpacing * (0.5 - 0.5 * detectorWidth),   //
+        0., 0., 1.;
+    Geometry::ProjectionMatrix kernelMatrix = A * P;
+    // The kernel multiplies matrix entries in single precision, large entries cancel out badly
+    return kernelMatrix / kernelMatrix.block< 3, 3 >(0, 0).cwiseAbs().maxCoeff();
+}
@@ -0,0 +1,41 @@
+/*
+ * ConeBeamGeometry.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <random>
+
+#include "ProjectionMatrix.h"
+#include "ProjectiveGeometry.hxx"
+
+// C-arm like cone-beam geometry for forward projections generated without CONRAD/pycuda.
+// World coordinates are in millimeters with the isocenter in the center of the volume.
+struct ConeBeamGeometry
+{
+    double sourceIsocenterDistance = 750.;
+    double sourceDetectorDistance  = 1200.;
+    int detectorWidth              = 620;
+    int detectorHeight             = 480;
+    double detectorSpacing         = 0.616;
+    double volumeSpacing           = 1.;
+
+    // Projection matrix mapping world coordinates to detector pixels (x: column, y: row) for a rotated C-arm
+    [[nodiscard]] auto projectionMatrix(const Geometry::RP3Homography& rotation) const -> Geometry::ProjectionMatrix;
+    // Random rotation about all three axes like in `epipolar.generate_projections`
+    [[nodiscard]] auto randomProjectionMatrix(std::mt19937& random) const -> Geometry::ProjectionMatrix;
+    // Same detector area with `factor` times larger pixels
+    [[nodiscard]] auto downscaled(int factor) const -> ConeBeamGeometry;
+};
+
+// Maps pixels of the full detector to pixels of `ConeBeamGeometry::downscaled(factor)`, pixel centers stay aligned like
+// in `cv::resize`
+auto downscaleProjectionMatrix(const Geometry::ProjectionMatrix& P, int factor) -> Geometry::ProjectionMatrix;
+
+// `projection_kernel` expects detector coordinates in millimeters relative to the detector center with the row index
+// as first coordinate. The result is only defined up to scale.
+auto toProjectionKernelConvention(const Geometry::ProjectionMatrix& P, int detectorWidth, int detectorHeight,
+                                  double detectorSpacing) -> Geometry::ProjectionMatrix;
@@ -8,37 +8,152 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
 #include <opencv2/opencv.hpp>
+#include <vector>
 
 #include "pybind11/numpy.h"
 #include "python_include.hpp"
 
-inline auto cvMatFromArray(const pybind11::array_t< float >& array) -> cv::Mat
+enum class CvMatMode {
+    View, // wraps the array memory if the rows are contiguous, copies otherwise
+    Copy  // always copies, e.g. if the result is modified
+};
+
+namespace detail
 {
-    cv::Mat mat(array.shape(0), array.shape(1), CV_32FC1);
-    // copy to be memory safe
-    assert(array.ndim() == 2 && "Must be 2d!");
-    for (int y = 0; y < array.shape(0); ++y)
+constexpr std::ptrdiff_t FLOAT_BYTES = sizeof(float);
+
+#if CV_VERSION_MAJOR >= 4
+using CvAccessFlag = cv::AccessFlag;
+#else
+using CvAccessFlag = int;
+#endif
+
+// Keeps the array behind a cv::Mat alive like the NumpyAllocator of OpenCV's Python bindings. Mats may be released on
+// worker threads that must not wait for the GIL (the GUI thread holds it), their arrays are released by the next
+// `cvMatFromArray` instead.
+class PyArrayAllocator : public cv::MatAllocator
+{
+  public:
+    // Requires the GIL
+    auto wrap(pybind11::array array, int rows, int cols, const void* data, size_t step) const -> cv::Mat
     {
-        for (int x = 0; x < array.shape(1); ++x)
+        releasePending();
+        cv::Mat mat(rows, cols, CV_32FC1, const_cast< void* >(data), step);
+        auto* u     = new cv::UMatData(this);
+        u->data     = mat.data;
+        u->origdata = mat.data;
+        u->size     = step * static_cast< size_t >(rows);
+        u->userdata = array.release().ptr();
+        mat.u       = u;
+        mat.addref();
+        mat.allocator = this;
+        return mat;
+    }
+
+    auto allocate(int /*dims*/, const int* /*sizes*/, int /*type*/, void* /*data*/, size_t* /*step*/,
+                  CvAccessFlag /*flags*/, cv::UMatUsageFlags /*usageFlags*/) const -> cv::UMatData* override
+    {
+        return nullptr; // only wraps existing arrays
+    }
+    auto allocate(cv::UMatData* /*data*/, CvAccessFlag /*flags*/, cv::UMatUsageFlags /*usageFlags*/) const
+        -> bool override
+    {
+        return false;
+    }
+
+    void deallocate(cv::UMatData* u) const override
+    {
+        if (!u)
         {
-            mat.at< float >(y, x) = array.at(y, x);
+            return;
         }
+        auto* object = static_cast< PyObject* >(u->userdata);
+        delete u;
+        if (PyGILState_Check())
+        {
+            Py_XDECREF(object);
+            return;
+        }
+        std::lock_guard< std::mutex > lock(m_mutex);
+        m_pending.push_back(object);
     }
-    return mat;
+
+  private:
+    void releasePending() const
+    {
+        std::vector< PyObject* > pending;
+        {
+            std::lock_guard< std::mutex > lock(m_mutex);
+            pending.swap(m_pending);
+        }
+        for (auto* object : pending)
+        {
+            Py_XDECREF(object);
+        }
+    }
+
+    mutable std::mutex m_mutex;
+    mutable std::vector< PyObject* > m_pending;
+};
+
+inline auto pyArrayAllocator() -> const PyArrayAllocator&
+{
+    static PyArrayAllocator allocator;
+    return allocator;
 }
 
-inline auto cvMatFromArray(const pybind11::array_t< float >& array, int sliceIdx) -> cv::Mat
+// Copies rows of `cols` floats that are `rowStride` bytes apart with elements `colStride` bytes apart
+inline void copyStrided(const char* source, std::ptrdiff_t rowStride, std::ptrdiff_t colStride, cv::Mat& mat)
 {
-    cv::Mat mat(array.shape(1), array.shape(2), CV_32FC1);
-    // copy to be memory safe
-    assert(array.ndim() == 3 && "Must be 3d!");
-    for (int y = 0; y < array.shape(1); ++y)
+    for (int y = 0; y < mat.rows; ++y)
     {
-        for (int x = 0; x < array.shape(2); ++x)
+        const char* row = source + y * rowStride;
+        auto* target    = mat.ptr< float >(y);
+        if (colStride == FLOAT_BYTES)
         {
-            mat.at< float >(y, x) = array.at(sliceIdx, y, x);
+            std::memcpy(target, row, static_cast< size_t >(mat.cols) * sizeof(float));
+            continue;
+        }
+        for (int x = 0; x < mat.cols; ++x)
+        {
+            std::memcpy(target + x, row + x * colStride, sizeof(float));
         }
     }
+}
+
+inline auto cvMatFromStrided(const pybind11::array_t< float >& array, const char* data, std::ptrdiff_t rows,
+                             std::ptrdiff_t cols, std::ptrdiff_t rowStride, std::ptrdiff_t colStride, CvMatMode mode)
+    -> cv::Mat
+{
+    if (mode == CvMatMode::View && colStride == FLOAT_BYTES && rowStride >= cols * colStride)
+    {
+        return pyArrayAllocator().wrap(array, static_cast< int >(rows), static_cast< int >(cols), data,
+                                       static_cast< size_t >(rowStride));
+    }
+    cv::Mat mat(static_cast< int >(rows), static_cast< int >(cols), CV_32FC1);
+    copyStrided(data, rowStride, colStride, mat);
     return mat;
 }
+} // namespace detail
+
+// The view keeps `array` alive, mapped volumes and other read-only arrays must not be written through it
+inline auto cvMatFromArray(const pybind11::array_t< float >& array, CvMatMode mode = CvMatMode::View) -> cv::Mat
+{
+    assert(array.ndim() == 2 && "Must be 2d!");
+    return detail::cvMatFromStrided(array, reinterpret_cast< const char* >(array.data()), array.shape(0),
+                                    array.shape(1), array.strides(0), array.strides(1), mode);
+}
+
+// Slice `sliceIdx` of a 3d array, mapped volumes are only read where the image is accessed
+inline auto cvMatFromArray(const pybind11::array_t< float >& array, int sliceIdx, CvMatMode mode = CvMatMode::View)
+    -> cv::Mat
+{
+    assert(array.ndim() == 3 && "Must be 3d!");
+    const auto* slice = reinterpret_cast< const char* >(array.data()) + sliceIdx * array.strides(0);
+    return detail::cvMatFromStrided(array, slice, array.shape(1), array.shape(2), array.strides(1), array.strides(2),
+                                    mode);
+}
@@ -0,0 +1,339 @@
+/*
+ * DicomReader.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "DicomReader.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+#include "ParallelImport.hpp"
+
+namespace
+{
+constexpr size_t PREAMBLE_SIZE      = 128;
+constexpr uint32_t UNDEFINED_LENGTH = 0xffffffffu;
+// Frame of multi-frame projections used by `epipolar.read_projection`
+constexpr int64_t PROJECTION_FRAME = 2;
+
+constexpr uint32_t tag(uint32_t group, uint32_t element)
+{
+    return group << 16 | element;
+}
+
+constexpr uint32_t TRANSFER_SYNTAX      = tag(0x0002, 0x0010);
+constexpr uint32_t SAMPLES_PER_PIXEL    = tag(0x0028, 0x0002);
+constexpr uint32_t NUMBER_OF_FRAMES     = tag(0x0028, 0x0008);
+constexpr uint32_t ROWS                 = tag(0x0028, 0x0010);
+constexpr uint32_t COLUMNS              = tag(0x0028, 0x0011);
+constexpr uint32_t BITS_ALLOCATED       = tag(0x0028, 0x0100);
+constexpr uint32_t BITS_STORED          = tag(0x0028, 0x0101);
+constexpr uint32_t PIXEL_REPRESENTATION = tag(0x0028, 0x0103);
+constexpr uint32_t PIXEL_DATA           = tag(0x7fe0, 0x0010);
+constexpr uint32_t ITEM                 = tag(0xfffe, 0xe000);
+constexpr uint32_t ITEM_DELIMITER       = tag(0xfffe, 0xe00d);
+constexpr uint32_t SEQUENCE_DELIMITER   = tag(0xfffe, 0xe0dd);
+
+const std::string IMPLICIT_VR_LITTLE_ENDIAN = "1.2.840.10008.1.2";
+const std::string EXPLICIT_VR_LITTLE_ENDIAN = "1.2.840.10008.1.2.1";
+
+struct Element
+{
+    uint32_t tag = 0;
+    std::string vr; // empty for implicit VR and items
+    uint32_t length = 0;
+    size_t value    = 0; // offset of the value
+};
+
+// Little endian data elements, only what is needed to find the image attributes and the pixel data
+class DicomParser
+{
+  public:
+    DicomParser(const std::vector< char >& bytes, size_t position) : m_bytes(bytes), m_position(position) {}
+
+    [[nodiscard]] auto atEnd() const -> bool { return m_position >= m_bytes.size(); }
+    [[nodiscard]] auto nextGroup() const -> uint32_t { return integer(m_position, 2); }
+    void setExplicitVr(bool explicitVr) { m_explicitVr = explicitVr; }
+
+    auto next() -> Element
+    {
+        Element element;
+        element.tag = tag(integer(m_position, 2), integer(m_position + 2, 2));
+        m_position += 4;
+        if (m_explicitVr && element.tag >> 16 != 0xfffe)
+        {
+            element.vr = std::string(&m_bytes[checked(m_position, 2)], 2);
+            m_position += 2;
+            if (hasLongLength(element.vr))
+            {
+                element.length = integer(m_position + 2, 4);
+                m_position += 6;
+            }
+            else
+            {
+                element.length = integer(m_position, 2);
+                m_position += 2;
+            }
+        }
+        else
+        {
+            element.length = integer(m_position, 4);
+            m_position += 4;
+        }
+        element.value = m_position;
+        return element;
+    }
+
+    // Moves behind the value of `element`, which is the last one returned by `next`
+    void skip(const Element& element)
+    {
+        if (element.length != UNDEFINED_LENGTH)
+        {
+            m_position = checked(element.value, element.length) + element.length;
+        }
+        else if (element.vr.empty() || element.vr == "SQ")
+        {
+            skipSequence();
+        }
+        else
+        {
+            throw std::runtime_error("Undefined length of a DICOM " + element.vr + " element");
+        }
+    }
+
+    [[nodiscard]] auto integer(size_t offset, size_t size) const -> uint32_t
+    {
+        const char* data = &m_bytes[checked(offset, size)];
+        uint32_t value   = 0;
+        for (size_t i = size; i-- > 0;)
+        {
+            value = value << 8 | static_cast< unsigned char >(data[i]);
+        }
+        return value;
+    }
+
+    [[nodiscard]] auto string(const Element& element) const -> std::string
+    {
+        std::string value(&m_bytes[checked(element.value, element.length)], element.length);
+        value.erase(std::find_if(value.rbegin(), value.rend(), [](char c) { return c != ' ' && c != '\0'; }).base(),
+                    value.end());
+        value.erase(0, value.find_first_not_of(' '));
+        return value;
+    }
+
+    // Throws if [offset, offset + size) is not inside the file
+    [[nodiscard]] auto checked(size_t offset, size_t size) const -> size_t
+    {
+        if (offset > m_bytes.size() || size > m_bytes.size() - offset)
+        {
+            throw std::runtime_error("Unexpected end of DICOM file");
+        }
+        return offset;
+    }
+
+  private:
+    static auto hasLongLength(const std::string& vr) -> bool
+    {
+        static const char* const LONG[] = { "OB", "OD", "OF", "OL", "OV", "OW", "SQ",
+                                            "SV", "UC", "UN", "UR", "UT", "UV" };
+        return std::any_of(std::begin(LONG), std::end(LONG), [&](const char* name) { return vr == name; });
+    }
+
+    // Items until the sequence delimiter, nested sequences of undefined length included
+    void skipSequence()
+    {
+        for (;;)
+        {
+            auto item = next();
+            if (item.tag == SEQUENCE_DELIMITER)
+            {
+                return;
+            }
+            if (item.tag != ITEM)
+            {
+                throw std::runtime_error("Broken DICOM sequence");
+            }
+            if (item.length != UNDEFINED_LENGTH)
+            {
+                skip(item);
+                continue;
+            }
+            for (auto element = next(); element.tag != ITEM_DELIMITER; element = next())
+            {
+                skip(element);
+            }
+        }
+    }
+
+    const std::vector< char >& m_bytes;
+    size_t m_position = 0;
+    bool m_explicitVr = true; // the file meta information always is
+};
+
+template< typename T >
+void convertFrame(const char* source, int64_t rows, int64_t columns, int bitsStored, cv::Mat& frame)
+{
+    // Signed samples are sign extended from their stored bits like pydicom does
+    using Unsigned     = std::make_unsigned_t< T >;
+    constexpr int BITS = 8 * sizeof(T);
+    int shift          = std::is_signed< T >::value ? BITS - bitsStored : 0;
+    for (int64_t row = 0; row < rows; ++row)
+    {
+        auto* values = frame.ptr< float >(static_cast< int >(row));
+        for (int64_t col = 0; col < columns; ++col)
+        {
+            const auto* bytes = reinterpret_cast< const unsigned char* >(source + (row * columns + col) * sizeof(T));
+            uint32_t raw      = 0;
+            for (size_t i = sizeof(T); i-- > 0;)
+            {
+                raw = raw << 8 | bytes[i];
+            }
+            values[col] = static_cast< float >(static_cast< T >(static_cast< Unsigned >(raw << shift)) >> shift);
+        }
+    }
+}
+} // namespace
+
+auto decodeDicomProjection(const std::vector< char >& bytes) -> cv::Mat
+{
+    if (bytes.size() < PREAMBLE_SIZE + 4 || std::string(&bytes[PREAMBLE_SIZE], 4) != "DICM")
+    {
+        throw std::runtime_error("No DICOM preamble");
+    }
+    DicomParser parser(bytes, PREAMBLE_SIZE + 4);
+
+    std::string transferSyntax;
+    while (!parser.atEnd() && parser.nextGroup() == 0x0002)
+    {
+        auto element = parser.next();
+        if (element.tag == TRANSFER_SYNTAX)
+        {
+            transferSyntax = parser.string(element);
+        }
+        parser.skip(element);
+    }
+    if (transferSyntax != IMPLICIT_VR_LITTLE_ENDIAN && transferSyntax != EXPLICIT_VR_LITTLE_ENDIAN)
+    {
+        throw std::runtime_error("Unsupported DICOM transfer syntax " + transferSyntax);
+    }
+    parser.setExplicitVr(transferSyntax == EXPLICIT_VR_LITTLE_ENDIAN);
+
+    int64_t samplesPerPixel = 1;
+    int64_t frames          = 1;
+    int64_t rows            = 0;
+    int64_t columns         = 0;
+    int bitsAllocated       = 0;
+    int bitsStored          = 0;
+    bool isSigned           = false;
+    Element pixelData;
+    while (!parser.atEnd())
+    {
+        auto element = parser.next();
+        switch (element.tag)
+        {
+        case SAMPLES_PER_PIXEL:
+            samplesPerPixel = parser.integer(element.value, 2);
+            break;
+        case NUMBER_OF_FRAMES:
+            frames = std::stoll(parser.string(element));
+            break;
+        case ROWS:
+            rows = parser.integer(element.value, 2);
+            break;
+        case COLUMNS:
+            columns = parser.integer(element.value, 2);
+            break;
+        case BITS_ALLOCATED:
+            bitsAllocated = static_cast< int >(parser.integer(element.value, 2));
+            break;
+        case BITS_STORED:
+            bitsStored = static_cast< int >(parser.integer(element.value, 2));
+            break;
+        case PIXEL_REPRESENTATION:
+            isSigned = parser.integer(element.value, 2) == 1;
+            break;
+        default:
+            break;
+        }
+        if (element.tag == PIXEL_DATA)
+        {
+            pixelData = element;
+            break;
+        }
+        parser.skip(element);
+    }
+
+    if (pixelData.tag != PIXEL_DATA)
+    {
+        throw std::runtime_error("No DICOM pixel data");
+    }
+    if (pixelData.length == UNDEFINED_LENGTH)
+    {
+        throw std::runtime_error("Encapsulated DICOM pixel data");
+    }
+    if (samplesPerPixel != 1 || (bitsAllocated != 8 && bitsAllocated != 16 && bitsAllocated != 32))
+    {
+        throw std::runtime_error("Unsupported DICOM pixel format");
+    }
+    // `read_projection` takes frame 2 of multi-frame images, anything else is left to it
+    if (frames <= PROJECTION_FRAME || rows <= 0 || columns <= 0)
+    {
+        throw std::runtime_error("DICOM file without frame 2");
+    }
+    auto frameBytes = rows * columns * bitsAllocated / 8;
+    if (static_cast< uint64_t >(frames * frameBytes) > pixelData.length)
+    {
+        throw std::runtime_error("DICOM pixel data shorter than its frames");
+    }
+    bitsStored = bitsStored > 0 && bitsStored <= bitsAllocated ? bitsStored : bitsAllocated;
+
+    const char* source =
+        &bytes[parser.checked(pixelData.value + PROJECTION_FRAME * frameBytes, static_cast< size_t >(frameBytes))];
+    cv::Mat frame(static_cast< int >(rows), static_cast< int >(columns), CV_32FC1);
+    switch (bitsAllocated)
+    {
+    case 8:
+        isSigned ? convertFrame< int8_t >(source, rows, columns, bitsStored, frame)
+                 : convertFrame< uint8_t >(source, rows, columns, bitsStored, frame);
+        break;
+    case 16:
+        isSigned ? convertFrame< int16_t >(source, rows, columns, bitsStored, frame)
+                 : convertFrame< uint16_t >(source, rows, columns, bitsStored, frame);
+        break;
+    default:
+        isSigned ? convertFrame< int32_t >(source, rows, columns, bitsStored, frame)
+                 : convertFrame< uint32_t >(source, rows, columns, bitsStored, frame);
+        break;
+    }
+
+    // Like `dc /= np.max(dc)` in float32. An empty frame would be all NaN, which is left to Python as well.
+    auto maximum = frame.ptr< float >(0)[0];
+    for (int row = 0; row < frame.rows; ++row)
+    {
+        const auto* values = frame.ptr< float >(row);
+        maximum            = std::max(maximum, *std::max_element(values, values + frame.cols));
+    }
+    if (maximum == 0.f)
+    {
+        throw std::runtime_error("DICOM frame with a maximum of 0");
+    }
+    for (int row = 0; row < frame.rows; ++row)
+    {
+        auto* values = frame.ptr< float >(row);
+        for (int col = 0; col < frame.cols; ++col)
+        {
+            values[col] /= maximum;
+        }
+    }
+    return frame;
+}
+
+auto readDicomProjection(const std::string& path) -> cv::Mat
+{
+    return decodeDicomProjection(readFileBytes(path));
+}
@@ -0,0 +1,21 @@
+/*
+ * DicomReader.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+// Native `epipolar.read_projection` for uncompressed DICOM files (implicit or explicit VR little endian): frame 2 of a
+// multi-frame image as CV_32FC1, normalized to a maximum of 1. Throws std::runtime_error for compressed transfer
+// syntaxes and everything else that pydicom may still decode (e.g. fewer than 3 frames), callers fall back to Python.
+// Thread-safe.
+auto decodeDicomProjection(const std::vector< char >& bytes) -> cv::Mat;
+
+// `decodeDicomProjection` of a file
+auto readDicomProjection(const std::string& path) -> cv::Mat;
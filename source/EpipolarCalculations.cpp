@@ -44,7 +44,13 @@ auto getEpipolarLines(const Geometry::ProjectionMatrix& p1, const Geometry::Proj
     qDebug() << detectorSpacing;
     Geometry::SourceDetectorGeometry geometry1(p1, detectorSpacing);
     Geometry::SourceDetectorGeometry geometry2(p2, detectorSpacing);
+    return getEpipolarLines(geometry1, geometry2, randomPoint);
+}
 
+auto getEpipolarLines(const Geometry::SourceDetectorGeometry& geometry1,
+                      const Geometry::SourceDetectorGeometry& geometry2, const Geometry::RP3Point& randomPoint)
+    -> std::pair< EpipolarScreenLine, EpipolarScreenLine >
+{
     qDebug() << "Random point: " << randomPoint(0) << ", " << randomPoint(1) << ", " << randomPoint(2) << ","
              << randomPoint(3);
 
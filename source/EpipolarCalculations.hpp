@@ -16,3 +16,7 @@
 auto getEpipolarLines(const Geometry::ProjectionMatrix& p1, const Geometry::ProjectionMatrix& p2,
                       const Geometry::RP3Point& randomPoint, double detectorSpacing)
     -> std::pair< EpipolarScreenLine, EpipolarScreenLine >;
+// Same with geometries that are already decomposed (e.g. from a `GeometryTable`)
+auto getEpipolarLines(const Geometry::SourceDetectorGeometry& geometry1,
+                      const Geometry::SourceDetectorGeometry& geometry2, const Geometry::RP3Point& randomPoint)
+    -> std::pair< EpipolarScreenLine, EpipolarScreenLine >;
@@ -0,0 +1,110 @@
+/*
+ * EpipolarPairTable.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "EpipolarPairTable.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "ParallelImport.hpp"
+
+EpipolarPairTable::EpipolarPairTable(std::shared_ptr< const GeometryTable > geometries)
+    : m_geometries(std::move(geometries))
+{
+}
+
+auto EpipolarPairTable::pair(size_t index1, size_t index2) -> ViewPair
+{
+    if (index1 == index2)
+    {
+        throw std::invalid_argument("A view does not have an epipolar geometry with itself");
+    }
+    if (index1 > index2)
+    {
+        return pair(index2, index1).swapped();
+    }
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        auto it = m_pairs.find(key(index1, index2));
+        if (it != m_pairs.end())
+        {
+            return it->second;
+        }
+    }
+    // Pairs may be computed twice if two threads miss at the same time, both results are the same
+    auto viewPair = compute(index1, index2);
+    std::lock_guard< std::mutex > lock(m_mutex);
+    m_pairs.emplace(key(index1, index2), viewPair);
+    return viewPair;
+}
+
+auto EpipolarPairTable::epipolarLine(size_t index1, size_t index2, const Geometry::RP2Point& point)
+    -> Geometry::RP2Line
+{
+    return pair(index1, index2).fundamental * point;
+}
+
+void EpipolarPairTable::fill(const std::vector< std::pair< size_t, size_t > >& pairs, int concurrency)
+{
+    std::vector< std::pair< size_t, size_t > > missing;
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        for (auto [index1, index2] : pairs)
+        {
+            if (index1 > index2)
+            {
+                std::swap(index1, index2);
+            }
+            if (index1 != index2 && !m_pairs.count(key(index1, index2)))
+            {
+                missing.emplace_back(index1, index2);
+            }
+        }
+    }
+
+    std::vector< ViewPair > computed(missing.size());
+    parallelFor(missing.size(), concurrency,
+                [&](size_t i) { computed[i] = compute(missing[i].first, missing[i].second); });
+
+    std::lock_guard< std::mutex > lock(m_mutex);
+    m_pairs.reserve(m_pairs.size() + missing.size());
+    for (size_t i = 0; i < missing.size(); ++i)
+    {
+        m_pairs.emplace(key(missing[i].first, missing[i].second), computed[i]);
+    }
+}
+
+void EpipolarPairTable::fillAll(int concurrency)
+{
+    std::vector< std::pair< size_t, size_t > > pairs;
+    pairs.reserve(size() * (size() - std::min< size_t >(size(), 1)) / 2);
+    for (size_t index1 = 0; index1 < size(); ++index1)
+    {
+        for (size_t index2 = index1 + 1; index2 < size(); ++index2)
+        {
+            pairs.emplace_back(index1, index2);
+        }
+    }
+    fill(pairs, concurrency);
+}
+
+auto EpipolarPairTable::cachedPairs() const -> size_t
+{
+    std::lock_guard< std::mutex > lock(m_mutex);
+    return m_pairs.size();
+}
+
+auto EpipolarPairTable::compute(size_t index1, size_t index2) const -> ViewPair
+{
+    const auto& projection1 = m_geometries->pixelProjection(index1);
+    const auto& projection2 = m_geometries->pixelProjection(index2);
+    ViewPair viewPair;
+    viewPair.fundamental = Geometry::computeFundamentalMatrix(projection1, projection2);
+    viewPair.epipole1    = projection1 * m_geometries->source(index2);
+    viewPair.epipole2    = projection2 * m_geometries->source(index1);
+    return viewPair;
+}
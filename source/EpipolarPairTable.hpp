@@ -0,0 +1,62 @@
+/*
+ * EpipolarPairTable.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "GeometryTable.hpp"
+#include "ProjectionMatrix.h"
+
+// Epipolar geometry of two views in the pixels of `GeometryTable::pixelProjection`
+struct ViewPair
+{
+    Geometry::FundamentalMatrix fundamental; // maps points of the first view to their epipolar lines in the second
+    Geometry::RP2Point epipole1;             // source of the second view projected to the first
+    Geometry::RP2Point epipole2;             // source of the first view projected to the second
+
+    [[nodiscard]] auto swapped() const -> ViewPair { return { fundamental.transpose(), epipole2, epipole1 }; }
+};
+
+// Fundamental matrices and epipoles of the view pairs of a pumpkin, computed when a pair is used for the first time.
+// Only pairs with index1 < index2 are stored, the other direction is the transposed matrix. Thread-safe.
+class EpipolarPairTable
+{
+  public:
+    explicit EpipolarPairTable(std::shared_ptr< const GeometryTable > geometries);
+
+    [[nodiscard]] auto geometries() const -> const GeometryTable& { return *m_geometries; }
+    [[nodiscard]] auto size() const -> size_t { return m_geometries->size(); }
+
+    // Pair of the distinct views `index1` and `index2`
+    auto pair(size_t index1, size_t index2) -> ViewPair;
+    // Epipolar line in view `index2` of `point`, given in the pixels of view `index1`
+    auto epipolarLine(size_t index1, size_t index2, const Geometry::RP2Point& point) -> Geometry::RP2Line;
+
+    // Computes the given pairs that are not in the table yet on up to `concurrency` threads
+    void fill(const std::vector< std::pair< size_t, size_t > >& pairs, int concurrency);
+    // All pairs. n * (n - 1) / 2 entries of about 160 bytes, e.g. 80 MB for 1000 views.
+    void fillAll(int concurrency);
+
+    [[nodiscard]] auto cachedPairs() const -> size_t;
+
+  private:
+    [[nodiscard]] auto compute(size_t index1, size_t index2) const -> ViewPair;
+    [[nodiscard]] auto key(size_t index1, size_t index2) const -> uint64_t
+    {
+        return static_cast< uint64_t >(index1) * m_geometries->size() + index2;
+    }
+
+    std::shared_ptr< const GeometryTable > m_geometries;
+    std::unordered_map< uint64_t, ViewPair > m_pairs;
+    mutable std::mutex m_mutex;
+};
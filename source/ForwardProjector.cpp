@@ -0,0 +1,612 @@
+/*
+ * ForwardProjector.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "ForwardProjector.hpp"
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "ConeBeamGeometry.hpp"
+#include "OccupancyGrid.hpp"
+#include "PacketProjector.hpp"
+#include "ProjectionMatrix.h"
+#include "TileScheduler.hpp"
+#include "projection_kernel.hpp"
+
+namespace
+{
+// Rays in continuous index coordinates of the volume: voxel i covers [i - 0.5, i + 0.5)
+struct RaySetup
+{
+    Eigen::Vector3d source;
+    Eigen::Vector3d directionX; // change of the ray direction per detector column
+    Eigen::Vector3d directionY; // change of the ray direction per detector row
+    Eigen::Vector3d direction0; // ray direction of pixel (0, 0)
+    double worldScale;          // converts index coordinates to millimeters
+
+    RaySetup(const VolumeView& volume, Geometry::ProjectionMatrix P)
+    {
+        Geometry::normalizeProjectionMatrix(P);
+        Eigen::Matrix3d Minv = P.block< 3, 3 >(0, 0).inverse();
+        Eigen::Vector3d halfSize(0.5 * volume.size[0], 0.5 * volume.size[1], 0.5 * volume.size[2]);
+
+        source     = -Minv * P.col(3) / volume.spacing + halfSize;
+        directionX = Minv.col(0) / volume.spacing;
+        directionY = Minv.col(1) / volume.spacing;
+        direction0 = Minv.col(2) / volume.spacing;
+        worldScale = volume.spacing;
+    }
+
+    [[nodiscard]] inline auto direction(int x, int y) const -> Eigen::Vector3d
+    {
+        return direction0 + y * directionY + x * directionX;
+    }
+};
+
+inline auto intersectBox(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction,
+                         const std::array< int64_t, 3 >& size, double& tMin, double& tMax) -> bool
+{
+    tMin = 0.;
+    tMax = std::numeric_limits< double >::infinity();
+    for (int a = 0; a < 3; ++a)
+    {
+        double lower = -0.5;
+        double upper = static_cast< double >(size[a]) - 0.5;
+        if (direction[a] == 0.)
+        {
+            if (origin[a] < lower || origin[a] >= upper)
+            {
+                return false;
+            }
+            continue;
+        }
+        double t0 = (lower - origin[a]) / direction[a];
+        double t1 = (upper - origin[a]) / direction[a];
+        tMin      = std::max(tMin, std::min(t0, t1));
+        tMax      = std::min(tMax, std::max(t0, t1));
+    }
+    return tMin < tMax;
+}
+
+template< SampleFormat FORMAT >
+inline auto sampleData(const VolumeView& volume)
+{
+    if constexpr (FORMAT == SampleFormat::Float32)
+    {
+        return volume.data;
+    }
+    else
+    {
+        return volume.samples;
+    }
+}
+
+template< SampleFormat FORMAT, typename Sample >
+inline auto sampleValue(Sample sample) -> double
+{
+    if constexpr (FORMAT == SampleFormat::Float16)
+    {
+        return halfToFloat(sample);
+    }
+    else
+    {
+        return static_cast< double >(sample);
+    }
+}
+
+// Amanatides-Woo traversal: integer voxel indices are advanced along the axis whose boundary is hit first,
+// the ray parameters of the next boundaries are updated by constant deltas. Returns sum of t-lengths times values.
+// `LINEAR` steps the memory offset by strides, otherwise by differences of the volume's offset tables. UInt16 levels
+// are summed as they are and dequantized once per segment.
+template< bool LINEAR, SampleFormat FORMAT >
+inline auto traverseVoxels(const VolumeView& volume, const Eigen::Vector3d& origin, const Eigen::Vector3d& direction,
+                           double tMin, double tMax, int64_t& samples) -> double
+{
+    constexpr double INF = std::numeric_limits< double >::infinity();
+    std::array< int64_t, 3 > idx{};
+    std::array< int64_t, 3 > step{};
+    std::array< double, 3 > tNext{};
+    std::array< double, 3 > tDelta{};
+
+    for (int a = 0; a < 3; ++a)
+    {
+        double entry = origin[a] + tMin * direction[a];
+        idx[a]       = std::clamp(static_cast< int64_t >(std::floor(entry + 0.5)), int64_t(0), volume.size[a] - 1);
+        if (direction[a] > 0.)
+        {
+            step[a]   = 1;
+            tDelta[a] = 1. / direction[a];
+            tNext[a]  = (static_cast< double >(idx[a]) + 0.5 - origin[a]) / direction[a];
+        }
+        else if (direction[a] < 0.)
+        {
+            step[a]   = -1;
+            tDelta[a] = -1. / direction[a];
+            tNext[a]  = (static_cast< double >(idx[a]) - 0.5 - origin[a]) / direction[a];
+        }
+        else
+        {
+            tDelta[a] = INF;
+            tNext[a]  = INF;
+        }
+    }
+
+    const auto* voxel = sampleData< FORMAT >(volume) + volume.offset(idx[0], idx[1], idx[2]);
+    std::array< int64_t, 3 > voxelStep{ step[0] * volume.stride[0], step[1] * volume.stride[1],
+                                        step[2] * volume.stride[2] };
+
+    double t   = tMin;
+    double sum = 0.;
+    while (t < tMax)
+    {
+        int a       = tNext[0] < tNext[1] ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+        double tEnd = std::min(tNext[a], tMax);
+        sum += (tEnd - t) * sampleValue< FORMAT >(*voxel);
+        ++samples;
+
+        t = tEnd;
+        idx[a] += step[a];
+        if (idx[a] < 0 || idx[a] >= volume.size[a])
+        {
+            break;
+        }
+        if constexpr (LINEAR)
+        {
+            voxel += voxelStep[a];
+        }
+        else
+        {
+            voxel += volume.offsets[a][idx[a]] - volume.offsets[a][idx[a] - step[a]];
+        }
+        tNext[a] += tDelta[a];
+    }
+    if constexpr (FORMAT == SampleFormat::UInt16)
+    {
+        return static_cast< double >(volume.scale) * sum + static_cast< double >(volume.bias) * (t - tMin);
+    }
+    return sum;
+}
+
+template< bool LINEAR, SampleFormat FORMAT >
+auto projectIncrementalRays(const VolumeView& volume, const RaySetup& setup, float* projection, int width,
+                            const DetectorTile& tile) -> int64_t
+{
+    int64_t samples = 0;
+    for (int y = tile.y0; y < tile.y1; ++y)
+    {
+        float* row = projection + static_cast< int64_t >(y) * width;
+        for (int x = tile.x0; x < tile.x1; ++x)
+        {
+            Eigen::Vector3d direction = setup.direction(x, y);
+            double tMin               = 0.;
+            double tMax               = 0.;
+            double sum                = 0.;
+            auto traverse = [&](double t0, double t1) {
+                sum += traverseVoxels< LINEAR, FORMAT >(volume, setup.source, direction, t0, t1, samples);
+            };
+            if (intersectBox(setup.source, direction, volume.size, tMin, tMax))
+            {
+                if (volume.occupancy)
+                {
+                    volume.occupancy->forEachOccupiedSegment(setup.source, direction, tMin, tMax, traverse);
+                }
+                else
+                {
+                    traverse(tMin, tMax);
+                }
+            }
+            row[x] = static_cast< float >(sum * direction.norm() * setup.worldScale);
+        }
+    }
+    return samples;
+}
+
+template< bool LINEAR >
+auto projectIncrementalTile(const VolumeView& volume, const RaySetup& setup, float* projection, int width,
+                            const DetectorTile& tile) -> int64_t
+{
+    switch (volume.format)
+    {
+    case SampleFormat::UInt16:
+        return projectIncrementalRays< LINEAR, SampleFormat::UInt16 >(volume, setup, projection, width, tile);
+    case SampleFormat::Float16:
+        return projectIncrementalRays< LINEAR, SampleFormat::Float16 >(volume, setup, projection, width, tile);
+    case SampleFormat::Float32:
+        break;
+    }
+    return projectIncrementalRays< LINEAR, SampleFormat::Float32 >(volume, setup, projection, width, tile);
+}
+
+auto projectIncrementalTile(const VolumeView& volume, const RaySetup& setup, float* projection, int width,
+                            const DetectorTile& tile) -> int64_t
+{
+    return volume.linear() ? projectIncrementalTile< true >(volume, setup, projection, width, tile)
+                           : projectIncrementalTile< false >(volume, setup, projection, width, tile);
+}
+
+// `projection_kernel` does not report its work, count its equidistant samples (unit step in index space)
+auto countEquidistantSamples(const VolumeView& volume, const RaySetup& setup, const DetectorTile& tile) -> int64_t
+{
+    int64_t samples = 0;
+    for (int y = tile.y0; y < tile.y1; ++y)
+    {
+        for (int x = tile.x0; x < tile.x1; ++x)
+        {
+            Eigen::Vector3d direction = setup.direction(x, y);
+            double tMin               = 0.;
+            double tMax               = 0.;
+            if (intersectBox(setup.source, direction, volume.size, tMin, tMax))
+            {
+                samples += static_cast< int64_t >(std::ceil((tMax - tMin) * direction.norm())) + 1;
+            }
+        }
+    }
+    return samples;
+}
+
+struct ScalarLanes
+{
+    static constexpr int WIDTH = 1;
+    using Float                = float;
+    using Int                  = int32_t;
+    using Mask                 = bool;
+
+    static inline auto set(float v) -> Float { return v; }
+    static inline auto seti(int32_t v) -> Int { return v; }
+    static inline auto iota() -> Float { return 0.f; }
+    static inline auto add(Float a, Float b) -> Float { return a + b; }
+    static inline auto sub(Float a, Float b) -> Float { return a - b; }
+    static inline auto mul(Float a, Float b) -> Float { return a * b; }
+    static inline auto div(Float a, Float b) -> Float { return a / b; }
+    static inline auto fmadd(Float a, Float b, Float c) -> Float { return a * b + c; }
+    static inline auto min(Float a, Float b) -> Float { return a < b ? a : b; }
+    static inline auto max(Float a, Float b) -> Float { return a > b ? a : b; }
+    static inline auto sqrt(Float a) -> Float { return std::sqrt(a); }
+    static inline auto ceil(Float a) -> Float { return std::ceil(a); }
+    static inline auto floor(Float a) -> Float { return std::floor(a); }
+    static inline auto lerp(Float a, Float b, Float t) -> Float { return a + t * (b - a); }
+    static inline auto toInt(Float a) -> Int { return static_cast< Int >(a); }
+    static inline auto addi(Int a, Int b) -> Int { return a + b; }
+    static inline auto muli(Int a, Int b) -> Int { return a * b; }
+    static inline auto clampi(Int a, Int lower, Int upper) -> Int { return std::clamp(a, lower, upper); }
+    static inline auto less(Float a, Float b) -> Mask { return a < b; }
+    static inline auto land(Mask a, Mask b) -> Mask { return a && b; }
+    static inline auto any(Mask m) -> bool { return m; }
+    static inline auto select(Mask m, Float a, Float b) -> Float { return m ? a : b; }
+    static inline auto gather(const float* base, Int offset, Mask m) -> Float { return m ? base[offset] : 0.f; }
+    static inline auto gatheri(const int32_t* base, Int index) -> Int { return base[index]; }
+    static inline auto gatheru16(const uint16_t* base, Int offset, Mask m) -> Int { return m ? base[offset] : 0; }
+    static inline auto toFloat(Int a) -> Float { return static_cast< Float >(a); }
+    static inline auto halfToFloat(Int half) -> Float { return ::halfToFloat(static_cast< uint16_t >(half)); }
+    static inline auto load(const float* p) -> Float { return *p; }
+    static inline void store(float* p, Float a) { *p = a; }
+};
+
+auto cpuSupports(SimdLevel level) -> bool
+{
+    switch (level)
+    {
+    case SimdLevel::Scalar:
+        return true;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    case SimdLevel::Avx2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case SimdLevel::Avx512:
+        return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return false;
+    }
+}
+
+// Returns false if the volume is too large for 32 bit gather offsets. Offset tables of bricked volumes are narrowed
+// into `offsets32`, which has to outlive the projection.
+auto makePacketSetup(const VolumeView& volume, const Geometry::ProjectionMatrix& P, float* projection, int width,
+                     int height, PacketSetup& packet, std::array< std::vector< int32_t >, 3 >& offsets32) -> bool
+{
+    int64_t maxOffset = 0;
+    for (int a = 0; a < 3; ++a)
+    {
+        if (volume.linear() && volume.stride[a] < 0)
+        {
+            return false;
+        }
+        maxOffset += volume.linear() ? (volume.size[a] - 1) * volume.stride[a]
+                                     : *std::max_element(volume.offsets[a], volume.offsets[a] + volume.size[a]);
+    }
+    if (maxOffset > std::numeric_limits< int32_t >::max())
+    {
+        return false;
+    }
+    for (int a = 0; a < 3 && !volume.linear(); ++a)
+    {
+        offsets32[a].assign(volume.offsets[a], volume.offsets[a] + volume.size[a]);
+        packet.offsets[a] = offsets32[a].data();
+    }
+
+    RaySetup setup(volume, P);
+    for (int a = 0; a < 3; ++a)
+    {
+        packet.source[a]     = static_cast< float >(setup.source[a]);
+        packet.direction0[a] = static_cast< float >(setup.direction0[a]);
+        packet.directionX[a] = static_cast< float >(setup.directionX[a]);
+        packet.directionY[a] = static_cast< float >(setup.directionY[a]);
+        packet.upper[a]      = static_cast< float >(volume.size[a]) - 0.5f;
+        packet.last[a]       = static_cast< int32_t >(volume.size[a] - 1);
+        packet.stride[a]     = static_cast< int32_t >(volume.stride[a]);
+    }
+    packet.worldScale = static_cast< float >(setup.worldScale);
+    packet.volume     = volume.data;
+    packet.format     = volume.format;
+    packet.samples    = volume.samples;
+    packet.scale      = volume.scale;
+    packet.bias       = volume.bias;
+    packet.projection = projection;
+    packet.width      = width;
+    packet.height     = height;
+    return true;
+}
+
+// Per-ray parameter range between the first and the last occupied cell of the rays in `tile` for the packet engine.
+// Rows are padded to `pitch` with empty ranges.
+void clipRaysToOccupied(const VolumeView& volume, const RaySetup& setup, const DetectorTile& tile, int pitch,
+                        std::vector< float >& rayStart, std::vector< float >& rayEnd)
+{
+    auto size = static_cast< size_t >(pitch) * static_cast< size_t >(tile.y1 - tile.y0);
+    rayStart.assign(size, std::numeric_limits< float >::max());
+    rayEnd.assign(size, 0.f);
+    for (int y = tile.y0; y < tile.y1; ++y)
+    {
+        for (int x = tile.x0; x < tile.x1; ++x)
+        {
+            Eigen::Vector3d direction = setup.direction(x, y);
+            double tMin               = 0.;
+            double tMax               = 0.;
+            if (intersectBox(setup.source, direction, volume.size, tMin, tMax) &&
+                volume.occupancy->clipToOccupied(setup.source, direction, tMin, tMax))
+            {
+                auto index      = static_cast< size_t >(y - tile.y0) * pitch + (x - tile.x0);
+                rayStart[index] = static_cast< float >(tMin);
+                rayEnd[index]   = static_cast< float >(tMax);
+            }
+        }
+    }
+}
+
+auto projectPackets(const PacketSetup& packet, SimdLevel simd, const DetectorTile& tile) -> int64_t
+{
+    int64_t samples = 0;
+    if (simd == SimdLevel::Avx512 && projectPacketsAvx512(packet, tile, samples))
+    {
+        return samples;
+    }
+    if ((simd == SimdLevel::Avx512 || simd == SimdLevel::Avx2) && projectPacketsAvx2(packet, tile, samples))
+    {
+        return samples;
+    }
+    return projectPacketTileFor< ScalarLanes >(packet, tile);
+}
+
+// `projection_kernel` on the pixels of `tile`, which are shifted to the origin of a smaller detector. Opens its own
+// parallel region, which only gets one thread if called from a parallel region.
+void projectGenerated(const VolumeView& volume, const Geometry::ProjectionMatrix& P, double detectorSpacing,
+                      float* projection, int width, const DetectorTile& tile)
+{
+    Eigen::Matrix3d shift;
+    shift << 1., 0., -tile.x0, //
+        0., 1., -tile.y0,      //
+        0., 0., 1.;
+    int tileWidth  = tile.x1 - tile.x0;
+    int tileHeight = tile.y1 - tile.y0;
+    auto T = toProjectionKernelConvention(shift * P, tileWidth, tileHeight, detectorSpacing).cast< float >().eval();
+    projection_kernel(T(0, 0), T(0, 1), T(2, 2), T(2, 3), T(0, 2), T(0, 3), T(1, 0), T(1, 1), T(1, 2), T(1, 3), T(2, 0),
+                      T(2, 1), projection + static_cast< int64_t >(tile.y0) * width + tile.x0,
+                      const_cast< float* >(volume.data), tileHeight, tileWidth, volume.size[0], volume.size[1],
+                      volume.size[2], width, 1, volume.stride[0], volume.stride[1], volume.stride[2], detectorSpacing,
+                      volume.spacing);
+}
+
+// Per-thread buffers for tracing tiles
+struct TileScratch
+{
+    std::vector< float > rayStart;
+    std::vector< float > rayEnd;
+};
+
+// Traces arbitrary tiles of one view, so that tiles of several views can be scheduled on the same threads.
+// Engines that cannot handle the volume fall back like in `forwardProject`.
+class ViewProjector
+{
+  public:
+    ViewProjector(const VolumeView& volume, const Geometry::ProjectionMatrix& P, double detectorSpacing,
+                  float* projection, int width, int height, const ProjectorOptions& options)
+        : m_volume(volume), m_P(P), m_setup(volume, P), m_detectorSpacing(detectorSpacing), m_projection(projection),
+          m_width(width), m_engine(options.engine)
+    {
+        if (m_engine == ProjectorEngine::Generated && volume.format != SampleFormat::Float32)
+        {
+            m_engine = ProjectorEngine::Packet;
+        }
+        if (m_engine == ProjectorEngine::Generated && !volume.linear())
+        {
+            m_engine = ProjectorEngine::Incremental;
+        }
+        if (m_engine == ProjectorEngine::Packet)
+        {
+            if (makePacketSetup(volume, P, projection, width, height, m_packet, m_offsets32))
+            {
+                m_simd = supportedSimdLevel(options.simd);
+            }
+            else
+            {
+                m_engine = ProjectorEngine::Incremental;
+            }
+        }
+    }
+
+    // Returns the number of samples
+    auto project(const DetectorTile& tile, TileScratch& scratch) const -> int64_t
+    {
+        switch (m_engine)
+        {
+        case ProjectorEngine::Generated:
+            projectGenerated(m_volume, m_P, m_detectorSpacing, m_projection, m_width, tile);
+            return countEquidistantSamples(m_volume, m_setup, tile);
+        case ProjectorEngine::Incremental:
+            return projectIncrementalTile(m_volume, m_setup, m_projection, m_width, tile);
+        case ProjectorEngine::Packet:
+        {
+            PacketSetup packet = m_packet;
+            if (m_volume.occupancy)
+            {
+                packet.rayPitch = (tile.x1 - tile.x0 + PacketSetup::PITCH_ALIGNMENT - 1) /
+                                  PacketSetup::PITCH_ALIGNMENT * PacketSetup::PITCH_ALIGNMENT;
+                clipRaysToOccupied(m_volume, m_setup, tile, packet.rayPitch, scratch.rayStart, scratch.rayEnd);
+                packet.rayStart = scratch.rayStart.data();
+                packet.rayEnd   = scratch.rayEnd.data();
+            }
+            return projectPackets(packet, m_simd, tile);
+        }
+        }
+        return 0;
+    }
+
+    // Rough number of samples in `tile` from the ray lengths at its corners and its center
+    [[nodiscard]] auto estimateCost(const DetectorTile& tile) const -> double
+    {
+        const int xs[] = { tile.x0, tile.x1 - 1, tile.x0, tile.x1 - 1, (tile.x0 + tile.x1) / 2 };
+        const int ys[] = { tile.y0, tile.y0, tile.y1 - 1, tile.y1 - 1, (tile.y0 + tile.y1) / 2 };
+        double length  = 0.;
+        for (int r = 0; r < 5; ++r)
+        {
+            Eigen::Vector3d direction = m_setup.direction(xs[r], ys[r]);
+            double tMin               = 0.;
+            double tMax               = 0.;
+            if (intersectBox(m_setup.source, direction, m_volume.size, tMin, tMax) &&
+                (!m_volume.occupancy || m_volume.occupancy->clipToOccupied(m_setup.source, direction, tMin, tMax)))
+            {
+                length += (tMax - tMin) * direction.norm();
+            }
+        }
+        return length / 5. * (tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+    }
+
+    [[nodiscard]] auto simd() const -> SimdLevel { return m_simd; }
+
+  private:
+    VolumeView m_volume;
+    Geometry::ProjectionMatrix m_P;
+    RaySetup m_setup;
+    double m_detectorSpacing;
+    float* m_projection;
+    int m_width;
+    ProjectorEngine m_engine;
+    SimdLevel m_simd = SimdLevel::Scalar;
+    PacketSetup m_packet{};
+    std::array< std::vector< int32_t >, 3 > m_offsets32;
+};
+// Projects all views tile by tile on a `TileScheduler`. Tiles are queued view by view, so that threads trace
+// neighboring rays of the same or of consecutive views at the same time and share the voxels in cache. Within a view,
+// tiles with long rays come first to avoid a tail of threads waiting for the last expensive tile.
+auto projectTiles(const std::vector< ViewProjector >& views, int width, int height,
+                  const std::atomic< bool >* cancelled, ProjectorStats& stats) -> void
+{
+    constexpr int TILE_WIDTH  = 64;
+    constexpr int TILE_HEIGHT = 8;
+
+    struct TileTask
+    {
+        size_t view;
+        DetectorTile tile;
+        double cost;
+    };
+    std::vector< TileTask > tasks;
+    std::vector< int64_t > order;
+    for (size_t v = 0; v < views.size(); ++v)
+    {
+        auto first = tasks.size();
+        for (int y = 0; y < height; y += TILE_HEIGHT)
+        {
+            for (int x = 0; x < width; x += TILE_WIDTH)
+            {
+                DetectorTile tile{ x, y, std::min(width, x + TILE_WIDTH), std::min(height, y + TILE_HEIGHT) };
+                tasks.push_back(TileTask{ v, tile, views[v].estimateCost(tile) });
+                order.push_back(static_cast< int64_t >(order.size()));
+            }
+        }
+        std::stable_sort(order.begin() + first, order.end(),
+                         [&tasks](int64_t a, int64_t b) { return tasks[a].cost > tasks[b].cost; });
+    }
+
+    struct alignas(64) ThreadState
+    {
+        TileScratch scratch;
+        int64_t samples = 0;
+    };
+    TileScheduler scheduler(order);
+    std::vector< ThreadState > threads(scheduler.threads());
+    scheduler.run([&](int64_t task, int thread) {
+        if (cancelled && cancelled->load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        threads[thread].samples += views[tasks[task].view].project(tasks[task].tile, threads[thread].scratch);
+    });
+
+    for (auto& thread : threads)
+    {
+        stats.samples += thread.samples;
+    }
+    stats.busySeconds = scheduler.busySeconds();
+    stats.idleSeconds = scheduler.idleSeconds();
+    stats.simd        = views.empty() ? SimdLevel::Scalar : views.front().simd();
+    stats.cancelled   = cancelled && cancelled->load();
+}
+} // namespace
+
+auto supportedSimdLevel(SimdLevel requested) -> SimdLevel
+{
+    for (auto level : { SimdLevel::Avx512, SimdLevel::Avx2 })
+    {
+        if ((requested == SimdLevel::Best || requested >= level) && cpuSupports(level))
+        {
+            return level;
+        }
+    }
+    return SimdLevel::Scalar;
+}
+
+auto forwardProject(const VolumeView& volume, const Geometry::ProjectionMatrix& P, double detectorSpacing,
+                    float* projection, int width, int height, const ProjectorOptions& options) -> ProjectorStats
+{
+    return forwardProjectBatch(volume, { P }, detectorSpacing, projection, width, height, options);
+}
+
+auto forwardProjectBatch(const VolumeView& volume, const std::vector< Geometry::ProjectionMatrix >& matrices,
+                         double detectorSpacing, float* projections, int width, int height,
+                         const ProjectorOptions& options) -> ProjectorStats
+{
+    ProjectorStats stats;
+    auto viewSize = static_cast< int64_t >(width) * height;
+    stats.rays    = viewSize * static_cast< int64_t >(matrices.size());
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector< ViewProjector > views;
+    views.reserve(matrices.size());
+    for (size_t v = 0; v < matrices.size(); ++v)
+    {
+        views.emplace_back(volume, matrices[v], detectorSpacing, projections + static_cast< int64_t >(v) * viewSize,
+                           width, height, options);
+    }
+    projectTiles(views, width, height, options.cancelled, stats);
+    stats.seconds = std::chrono::duration< double >(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
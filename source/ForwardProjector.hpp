@@ -0,0 +1,119 @@
+/*
+ * ForwardProjector.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "ProjectiveGeometry.hxx"
+#include "SampleFormat.hpp"
+
+class OccupancyGrid;
+
+// Non-owning view on a (possibly strided) volume of float or 16 bit samples (see CompactVolume). Voxel (i, j, k) is
+// centered at world position ((i, j, k) - size / 2) * spacing, like in `projection_kernel`.
+struct VolumeView
+{
+    const float* data = nullptr;
+    // 16 bit samples for the compact formats instead of `data`, followed by one sample of padding for 32 bit gathers
+    SampleFormat format     = SampleFormat::Float32;
+    const uint16_t* samples = nullptr;
+    float scale             = 1.f; // UInt16: value = scale * sample + bias
+    float bias              = 0.f;
+    std::array< int64_t, 3 > size{};
+    std::array< int64_t, 3 > stride{}; // in elements
+    double spacing = 1.;
+    // Per-axis offset tables for non-linear layouts (see BrickedVolume), `stride` is unused if set
+    std::array< const int64_t*, 3 > offsets{};
+    // Optional, empty cells are skipped by the incremental and packet engines
+    const OccupancyGrid* occupancy = nullptr;
+    // Content hash for caching projections (see `contentHash`), 0 if unknown
+    uint64_t id = 0;
+
+    [[nodiscard]] inline auto linear() const -> bool { return offsets[0] == nullptr; }
+    [[nodiscard]] inline auto offset(int64_t i, int64_t j, int64_t k) const -> int64_t
+    {
+        return linear() ? i * stride[0] + j * stride[1] + k * stride[2] : offsets[0][i] + offsets[1][j] + offsets[2][k];
+    }
+    [[nodiscard]] inline auto at(int64_t i, int64_t j, int64_t k) const -> float
+    {
+        switch (format)
+        {
+        case SampleFormat::UInt16:
+            return scale * samples[offset(i, j, k)] + bias;
+        case SampleFormat::Float16:
+            return halfToFloat(samples[offset(i, j, k)]);
+        case SampleFormat::Float32:
+            break;
+        }
+        return data[offset(i, j, k)];
+    }
+};
+
+enum class ProjectorEngine {
+    Generated,   // `projection_kernel`: trilinear samples at equidistant steps
+    Incremental, // Siddon/Amanatides-Woo voxel traversal with precomputed deltas
+    Packet       // Packets of neighboring rays in SIMD lanes, trilinear samples at equidistant steps
+};
+
+// Instruction set for the packet engine. Falls back to the next lower level that is supported by the CPU.
+enum class SimdLevel { Scalar, Avx2, Avx512, Best };
+
+struct ProjectorOptions
+{
+    ProjectorEngine engine = ProjectorEngine::Generated;
+    SimdLevel simd         = SimdLevel::Best;
+
+    // Checked before each detector tile, the remaining tiles are skipped once it is set
+    const std::atomic< bool >* cancelled = nullptr;
+};
+
+struct ProjectorStats
+{
+    int64_t rays    = 0;
+    int64_t samples = 0; // voxels visited or sample positions along all rays
+    double seconds  = 0.;
+    SimdLevel simd  = SimdLevel::Scalar;
+    bool cancelled  = false; // the projections are incomplete
+    // Per thread: time spent tracing tiles and time spent waiting for work, to check the scaling
+    std::vector< double > busySeconds;
+    std::vector< double > idleSeconds;
+
+    [[nodiscard]] auto raysPerSecond() const -> double { return seconds > 0. ? rays / seconds : 0.; }
+    [[nodiscard]] auto samplesPerSecond() const -> double { return seconds > 0. ? samples / seconds : 0.; }
+    // Fraction of the threads' time spent tracing, 1 for perfect load balance
+    [[nodiscard]] auto threadEfficiency() const -> double
+    {
+        double busy = std::accumulate(busySeconds.begin(), busySeconds.end(), 0.);
+        double idle = std::accumulate(idleSeconds.begin(), idleSeconds.end(), 0.);
+        return busy + idle > 0. ? busy / (busy + idle) : 1.;
+    }
+};
+
+// Highest level <= `requested` that can be executed on this machine
+auto supportedSimdLevel(SimdLevel requested) -> SimdLevel;
+
+// Computes line integrals (in mm) for each detector pixel. The generated kernel only supports linear float volumes,
+// bricked volumes are traced by the incremental engine and compact volumes by the packet engine instead. `P` maps
+// world coordinates to pixels (x: column, y: row), the projection is C-contiguous with `height` rows and `width`
+// columns.
+//
+// The detector is split into tiles which are scheduled on the threads by `TileScheduler`, longest estimated rays
+// first.
+auto forwardProject(const VolumeView& volume, const Geometry::ProjectionMatrix& P, double detectorSpacing,
+                    float* projection, int width, int height, const ProjectorOptions& options = {}) -> ProjectorStats;
+
+// Projects the volume for each of `matrices` into a C-contiguous stack of `matrices.size()` x `height` x `width`.
+// Faster than projecting view by view: all views share one thread team and detector tiles of consecutive views are
+// traced back to back while the volume is still in cache.
+auto forwardProjectBatch(const VolumeView& volume, const std::vector< Geometry::ProjectionMatrix >& matrices,
+                         double detectorSpacing, float* projections, int width, int height,
+                         const ProjectorOptions& options = {}) -> ProjectorStats;
@@ -0,0 +1,214 @@
+/*
+ * GantryIndex.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "GantryIndex.hpp"
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+constexpr double TWO_PI = 2. * M_PI;
+
+// Least squares intersection of the principal rays, the mean source position if they are (nearly) parallel
+auto findIsocenter(const std::vector< Eigen::Vector3d >& sources, const std::vector< Eigen::Vector3d >& directions)
+    -> Eigen::Vector3d
+{
+    Eigen::Matrix3d normal = Eigen::Matrix3d::Zero();
+    Eigen::Vector3d right  = Eigen::Vector3d::Zero();
+    Eigen::Vector3d mean   = Eigen::Vector3d::Zero();
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        Eigen::Matrix3d rejection = Eigen::Matrix3d::Identity() - directions[i] * directions[i].transpose();
+        normal += rejection;
+        right += rejection * sources[i];
+        mean += sources[i];
+    }
+    mean /= static_cast< double >(std::max< size_t >(sources.size(), 1));
+
+    Eigen::SelfAdjointEigenSolver< Eigen::Matrix3d > solver(normal);
+    if (solver.eigenvalues()(0) <= 1e-6 * solver.eigenvalues()(2))
+    {
+        return mean;
+    }
+    return normal.ldlt().solve(right);
+}
+
+// First index in [begin, end) for which `predicate` holds, `end` if none. `predicate` must be false up to some index
+// and true from there on.
+template< typename Predicate >
+auto firstOf(size_t begin, size_t end, Predicate predicate) -> size_t
+{
+    while (begin < end)
+    {
+        auto middle = begin + (end - begin) / 2;
+        if (predicate(middle))
+        {
+            end = middle;
+        }
+        else
+        {
+            begin = middle + 1;
+        }
+    }
+    return begin;
+}
+} // namespace
+
+auto BaselinePairs::sample(std::mt19937& random) const -> std::pair< size_t, size_t >
+{
+    std::uniform_int_distribution< size_t > position(0, m_order.size() - 1);
+    std::uniform_real_distribution<> uniform(0., 1.);
+    auto first = position(random);
+    if (uniform(random) >= m_probability[first])
+    {
+        first = m_alias[first];
+    }
+    std::uniform_int_distribution< size_t > offset(0, m_partners[first] - 1);
+    auto second = (m_first[first] + offset(random)) % m_order.size();
+
+    // Both orders are equally likely, each pair is only stored once
+    if (random() & 1u)
+    {
+        return { m_order[second], m_order[first] };
+    }
+    return { m_order[first], m_order[second] };
+}
+
+GantryIndex::GantryIndex(const GeometryTable& geometries)
+{
+    auto n = geometries.size();
+    std::vector< Eigen::Vector3d > sources(n);
+    std::vector< Eigen::Vector3d > directions(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        sources[i]    = geometries.source(i).head< 3 >() / geometries.source(i)(3);
+        directions[i] = (geometries.principalPoint(i).head< 3 >() / geometries.principalPoint(i)(3) - sources[i])
+                            .normalized();
+    }
+    m_isocenter = findIsocenter(sources, directions);
+
+    // Rotation plane: the normal is the direction in which the sources vary least
+    Eigen::Matrix3d scatter = Eigen::Matrix3d::Zero();
+    for (const auto& source : sources)
+    {
+        scatter += (source - m_isocenter) * (source - m_isocenter).transpose();
+    }
+    Eigen::Vector3d axis = Eigen::SelfAdjointEigenSolver< Eigen::Matrix3d >(scatter).eigenvectors().col(0);
+    Eigen::Vector3d zero = n ? Eigen::Vector3d(sources[0] - m_isocenter) : Eigen::Vector3d::Zero();
+    zero -= axis * axis.dot(zero);
+    zero = zero.norm() > 0. ? zero.normalized() : Eigen::Vector3d(axis.unitOrthogonal());
+    Eigen::Vector3d ninety = axis.cross(zero);
+
+    m_angles.resize(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        Eigen::Vector3d offset = sources[i] - m_isocenter;
+        m_angles[i]            = std::atan2(ninety.dot(offset), zero.dot(offset));
+    }
+    m_order.resize(n);
+    std::iota(m_order.begin(), m_order.end(), size_t(0));
+    std::stable_sort(m_order.begin(), m_order.end(), [&](size_t a, size_t b) { return m_angles[a] < m_angles[b]; });
+}
+
+auto GantryIndex::baselineAngle(size_t i, size_t j) const -> double
+{
+    auto difference = std::abs(m_angles[i] - m_angles[j]);
+    return std::min(difference, TWO_PI - difference);
+}
+
+auto GantryIndex::pairs(double minAngle, double maxAngle) const -> BaselinePairs
+{
+    BaselinePairs pairs;
+    auto n   = size();
+    minAngle = std::max(minAngle, 0.);
+    maxAngle = std::min(maxAngle, M_PI);
+    if (n < 2 || minAngle > maxAngle)
+    {
+        return pairs;
+    }
+
+    // Each pair is counted once: from the view with the smaller angle if their difference is at most half a turn,
+    // otherwise from the other one, with the partner one turn later. Both sides test the same difference, so pairs
+    // exactly half a turn apart are neither lost nor counted twice by rounding. Partners of a position follow it in the
+    // sorted order (wrapping around), so they are one contiguous range.
+    std::vector< double > angles(n);
+    for (size_t p = 0; p < n; ++p)
+    {
+        angles[p] = m_angles[m_order[p]];
+    }
+    pairs.m_order = m_order;
+    pairs.m_first.resize(n);
+    pairs.m_partners.resize(n);
+    for (size_t p = 0; p < n; ++p)
+    {
+        // Following positions q with a baseline of angles[q] - angles[p], which increases with q
+        auto forward      = [&](size_t q) { return angles[q] - angles[p]; };
+        auto forwardBegin = firstOf(p + 1, n, [&](size_t q) { return forward(q) >= minAngle; });
+        auto forwardEnd   = firstOf(forwardBegin, n, [&](size_t q) { return forward(q) > maxAngle; });
+        // Preceding positions x with a difference of more than half a turn, the baseline increases with x
+        auto difference   = [&](size_t x) { return angles[p] - angles[x]; };
+        auto wrappedBegin = firstOf(0, p, [&](size_t x) { return TWO_PI - difference(x) >= minAngle; });
+        auto wrappedEnd   = firstOf(wrappedBegin, p, [&](size_t x) {
+            return TWO_PI - difference(x) > maxAngle || !(difference(x) > M_PI);
+        });
+
+        auto forwardCount = forwardEnd - forwardBegin;
+        auto wrappedCount = wrappedEnd - wrappedBegin;
+        // Only contiguous if the following partners reach the end, which rounding could violate by one position
+        if (forwardCount && wrappedCount && (forwardEnd != n || wrappedBegin != 0))
+        {
+            wrappedCount = 0;
+        }
+        pairs.m_first[p]    = forwardCount ? forwardBegin : wrappedBegin;
+        pairs.m_partners[p] = static_cast< uint32_t >(forwardCount + wrappedCount);
+        pairs.m_count += pairs.m_partners[p];
+    }
+    if (!pairs.m_count)
+    {
+        return BaselinePairs();
+    }
+
+    // Vose's alias method with weights proportional to the number of partners
+    pairs.m_probability.resize(n);
+    pairs.m_alias.resize(n);
+    std::vector< uint32_t > small;
+    std::vector< uint32_t > large;
+    for (size_t p = 0; p < n; ++p)
+    {
+        pairs.m_probability[p] = static_cast< double >(pairs.m_partners[p]) * static_cast< double >(n) /
+                                 static_cast< double >(pairs.m_count);
+        pairs.m_alias[p] = static_cast< uint32_t >(p);
+        (pairs.m_probability[p] < 1. ? small : large).push_back(static_cast< uint32_t >(p));
+    }
+    while (!small.empty() && !large.empty())
+    {
+        auto less = small.back();
+        auto more = large.back();
+        small.pop_back();
+        pairs.m_alias[less] = more;
+        pairs.m_probability[more] -= 1. - pairs.m_probability[less];
+        if (pairs.m_probability[more] < 1.)
+        {
+            large.pop_back();
+            small.push_back(more);
+        }
+    }
+    // Left overs only differ from 1 by rounding errors, positions without partners must still never be chosen
+    auto withPartners = static_cast< uint32_t >(
+        std::find_if(pairs.m_partners.begin(), pairs.m_partners.end(), [](uint32_t count) { return count > 0; }) -
+        pairs.m_partners.begin());
+    small.insert(small.end(), large.begin(), large.end());
+    for (auto p : small)
+    {
+        pairs.m_probability[p] = pairs.m_partners[p] ? 1. : 0.;
+        pairs.m_alias[p]       = pairs.m_partners[p] ? p : withPartners;
+    }
+    return pairs;
+}
@@ -0,0 +1,66 @@
+/*
+ * GantryIndex.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <Eigen/Core>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "GeometryTable.hpp"
+
+// View pairs whose baseline angle lies in a range, sampled uniformly in O(1) with an alias table over the first views
+class BaselinePairs
+{
+  public:
+    BaselinePairs() = default;
+
+    [[nodiscard]] auto empty() const -> bool { return m_count == 0; }
+    // Number of unordered pairs in the range
+    [[nodiscard]] auto count() const -> uint64_t { return m_count; }
+    // View indices of a random pair in random order. Must not be empty.
+    auto sample(std::mt19937& random) const -> std::pair< size_t, size_t >;
+
+  private:
+    friend class GantryIndex;
+
+    std::vector< size_t > m_order;     // views sorted by gantry angle
+    std::vector< size_t > m_first;     // per position of `m_order`: first partner, counted in the sorted order
+    std::vector< uint32_t > m_partners; // per position: number of partners following it within the range
+    std::vector< double > m_probability;
+    std::vector< uint32_t > m_alias;
+    uint64_t m_count = 0;
+};
+
+// Views of a pumpkin sorted by their gantry angle. The angles are measured around the isocenter (the point closest to
+// all principal rays) in the plane that fits the source positions best. The baseline angle of a pair is the angle
+// between its sources seen from the isocenter.
+class GantryIndex
+{
+  public:
+    GantryIndex() = default;
+    explicit GantryIndex(const GeometryTable& geometries);
+
+    [[nodiscard]] auto size() const -> size_t { return m_order.size(); }
+    // Gantry angle of view `i` in (-pi, pi]
+    [[nodiscard]] auto angle(size_t i) const -> double { return m_angles[i]; }
+    // View indices in order of increasing gantry angle
+    [[nodiscard]] auto order() const -> const std::vector< size_t >& { return m_order; }
+    [[nodiscard]] auto isocenter() const -> const Eigen::Vector3d& { return m_isocenter; }
+    // Baseline angle of views `i` and `j` in [0, pi]
+    [[nodiscard]] auto baselineAngle(size_t i, size_t j) const -> double;
+
+    // All pairs of distinct views with a baseline angle in [minAngle, maxAngle] (radians). O(n log n).
+    [[nodiscard]] auto pairs(double minAngle, double maxAngle) const -> BaselinePairs;
+
+  private:
+    std::vector< double > m_angles;
+    std::vector< size_t > m_order;
+    Eigen::Vector3d m_isocenter = Eigen::Vector3d::Zero();
+};
@@ -0,0 +1,58 @@
+/*
+ * GeometryTable.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "GeometryTable.hpp"
+
+GeometryTable::GeometryTable(const std::vector< Geometry::ProjectionMatrix >& matrices, double detectorSpacing)
+    : m_detectorSpacing(detectorSpacing)
+{
+    m_sources.reserve(matrices.size());
+    m_detectorOrigins.reserve(matrices.size());
+    m_uAxes.reserve(matrices.size());
+    m_vAxes.reserve(matrices.size());
+    m_principalPoints.reserve(matrices.size());
+    m_principalPlanes.reserve(matrices.size());
+    m_imagePlanes.reserve(matrices.size());
+    m_centralProjections.reserve(matrices.size());
+    m_pixelProjections.reserve(matrices.size());
+    for (const auto& matrix : matrices)
+    {
+        Geometry::SourceDetectorGeometry geometry(matrix, detectorSpacing);
+        m_sources.push_back(geometry.C);
+        m_detectorOrigins.push_back(geometry.O);
+        m_uAxes.push_back(geometry.U);
+        m_vAxes.push_back(geometry.V);
+        m_principalPoints.push_back(geometry.principal_point_3d);
+        m_principalPlanes.push_back(geometry.principal_plane);
+        m_imagePlanes.push_back(geometry.image_plane);
+        m_centralProjections.push_back(geometry.central_projection);
+
+        // `project` dehomogenizes the point on the detector before it subtracts O. Here O is scaled by the homogeneous
+        // coordinate instead, which gives the same pixel up to the scale of its homogeneous coordinates.
+        Geometry::ProjectionMatrix toPixels = Geometry::ProjectionMatrix::Zero();
+        toPixels.block< 1, 4 >(0, 0)        = geometry.U.transpose();
+        toPixels.block< 1, 4 >(1, 0)        = geometry.V.transpose();
+        toPixels(0, 3)                      = -geometry.U.dot(geometry.O);
+        toPixels(1, 3)                      = -geometry.V.dot(geometry.O);
+        toPixels(2, 3)                      = geometry.U.norm() * geometry.V.norm();
+        m_pixelProjections.push_back(toPixels * geometry.central_projection);
+    }
+}
+
+auto GeometryTable::geometry(size_t i) const -> Geometry::SourceDetectorGeometry
+{
+    // The constructor normalizes the axes, they are assigned with their pixel size
+    Geometry::SourceDetectorGeometry geometry(m_sources[i], m_detectorOrigins[i], m_uAxes[i].head< 3 >(),
+                                              m_vAxes[i].head< 3 >());
+    geometry.U                  = m_uAxes[i];
+    geometry.V                  = m_vAxes[i];
+    geometry.principal_point_3d = m_principalPoints[i];
+    geometry.principal_plane    = m_principalPlanes[i];
+    geometry.image_plane        = m_imagePlanes[i];
+    geometry.central_projection = m_centralProjections[i];
+    return geometry;
+}
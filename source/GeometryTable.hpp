@@ -0,0 +1,59 @@
+/*
+ * GeometryTable.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "ProjectiveGeometry.hxx"
+#include "SourceDetectorGeometry.h"
+
+// Source-detector geometries of all views of a pumpkin, decomposed once after the pumpkin was imported instead of in
+// every round. One array per member of `Geometry::SourceDetectorGeometry`, indexed by view.
+class GeometryTable
+{
+  public:
+    GeometryTable() = default;
+    GeometryTable(const std::vector< Geometry::ProjectionMatrix >& matrices, double detectorSpacing);
+
+    [[nodiscard]] auto size() const -> size_t { return m_sources.size(); }
+    [[nodiscard]] auto detectorSpacing() const -> double { return m_detectorSpacing; }
+
+    [[nodiscard]] auto source(size_t i) const -> const Geometry::RP3Point& { return m_sources[i]; }
+    [[nodiscard]] auto detectorOrigin(size_t i) const -> const Geometry::RP3Point& { return m_detectorOrigins[i]; }
+    [[nodiscard]] auto uAxis(size_t i) const -> const Geometry::RP3Point& { return m_uAxes[i]; }
+    [[nodiscard]] auto vAxis(size_t i) const -> const Geometry::RP3Point& { return m_vAxes[i]; }
+    [[nodiscard]] auto principalPoint(size_t i) const -> const Geometry::RP3Point& { return m_principalPoints[i]; }
+    [[nodiscard]] auto principalPlane(size_t i) const -> const Geometry::RP3Plane& { return m_principalPlanes[i]; }
+    [[nodiscard]] auto imagePlane(size_t i) const -> const Geometry::RP3Plane& { return m_imagePlanes[i]; }
+    [[nodiscard]] auto centralProjection(size_t i) const -> const Geometry::RP3Homography&
+    {
+        return m_centralProjections[i];
+    }
+
+    // Homogeneous version of `Geometry::SourceDetectorGeometry::project`. Differs from the imported matrix by its scale
+    // and, for negative detector spacings, by the direction of the v axis.
+    [[nodiscard]] auto pixelProjection(size_t i) const -> const Geometry::ProjectionMatrix&
+    {
+        return m_pixelProjections[i];
+    }
+
+    // Same as `Geometry::SourceDetectorGeometry(matrices[i], detectorSpacing)`, without the decomposition
+    [[nodiscard]] auto geometry(size_t i) const -> Geometry::SourceDetectorGeometry;
+
+  private:
+    std::vector< Geometry::RP3Point > m_sources;
+    std::vector< Geometry::RP3Point > m_detectorOrigins;
+    std::vector< Geometry::RP3Point > m_uAxes;
+    std::vector< Geometry::RP3Point > m_vAxes;
+    std::vector< Geometry::RP3Point > m_principalPoints;
+    std::vector< Geometry::RP3Plane > m_principalPlanes;
+    std::vector< Geometry::RP3Plane > m_imagePlanes;
+    std::vector< Geometry::RP3Homography > m_centralProjections;
+    std::vector< Geometry::ProjectionMatrix > m_pixelProjections;
+    double m_detectorSpacing = 1.;
+};
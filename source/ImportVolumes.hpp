@@ -7,34 +7,126 @@
 
 #pragma once
 #include <QDebug>
+#include <QDir>
+#include <algorithm>
 #include <cstdio>
+#include <memory>
+#include <optional>
+#include <random>
 #include <stdexcept>
 #include <string>
 #include <tuple>
 #include <vector>
 
+#include "CompactVolume.hpp"
+#include "ConeBeamGeometry.hpp"
+#include "CvPybindInterop.hpp"
+#include "DicomReader.hpp"
+#include "ForwardProjector.hpp"
+#include "MappedVolume.hpp"
+#include "PackedDataset.hpp"
+#include "ParallelImport.hpp"
+#include "ProjectionCache.hpp"
+#include "ProjectionDataset.hpp"
 #include "ProjectiveGeometry.hxx"
+#include "VolumeLoader.hpp"
 #include "pybind11/eigen.h"
 #include "pybind11/numpy.h"
 #include "pybind11/pybind11.h"
+#include "pybind11/stl.h"
 #include "python_include.hpp"
 
+enum class ProjectionBackend { Python, Native };
+
+// Memory mapping behind an array (mapped volume, packed dataset) with the content hash stored in the file. Arrays keep
+// it alive by a capsule as base object.
+struct MappedArrayOwner
+{
+    std::shared_ptr< const void > mapping;
+    uint64_t hash = 0;
+};
+constexpr const char* MAPPED_ARRAY_CAPSULE = "epipolar.MappedArray";
+
+// Read-only array of `size` C-contiguous floats at `data` within `mapping`
+inline auto arrayFromMapping(std::shared_ptr< const void > mapping, const float* data,
+                             const std::array< int64_t, 3 >& size, uint64_t hash) -> pybind11::array_t< float >
+{
+    namespace py = pybind11;
+    using namespace pybind11::literals;
+
+    auto* owner  = new MappedArrayOwner{ std::move(mapping), hash };
+    auto capsule = py::reinterpret_steal< py::object >(PyCapsule_New(owner, MAPPED_ARRAY_CAPSULE, [](PyObject* o) {
+        delete static_cast< MappedArrayOwner* >(PyCapsule_GetPointer(o, MAPPED_ARRAY_CAPSULE));
+    }));
+    if (!capsule)
+    {
+        delete owner;
+        throw py::error_already_set();
+    }
+    py::array_t< float > array({ size[0], size[1], size[2] }, data, capsule);
+    array.attr("setflags")("write"_a = false);
+    return array;
+}
+
+// Mapping behind an array of `importVolumes`, nullptr if the array owns its data
+inline auto mappedArrayOf(const pybind11::array& array) -> const MappedArrayOwner*
+{
+    auto base = array.base();
+    if (!base || !PyCapsule_IsValid(base.ptr(), MAPPED_ARRAY_CAPSULE))
+    {
+        return nullptr;
+    }
+    return static_cast< const MappedArrayOwner* >(PyCapsule_GetPointer(base.ptr(), MAPPED_ARRAY_CAPSULE));
+}
+
+// Takes ownership of the buffer of `volume` without copying. Mapped volumes become read-only arrays that keep the
+// mapping alive. Mapped volumes with uint16 samples have no float array, see `compactFromLoadedVolume`.
+inline auto arrayFromLoadedVolume(LoadedVolume volume) -> pybind11::array_t< float >
+{
+    if (volume.mapped)
+    {
+        const auto& mapped = *volume.mapped;
+        if (mapped.format() != SampleFormat::Float32)
+        {
+            throw std::runtime_error("Mapped volume without float samples: " + mapped.path());
+        }
+        return arrayFromMapping(volume.mapped, mapped.data(), mapped.size(), mapped.hash());
+    }
+
+    float* data = volume.data.release();
+    pybind11::capsule owner(data, [](void* pointer) { AlignedDelete()(static_cast< float* >(pointer)); });
+    return pybind11::array_t< float >({ volume.size[0], volume.size[1], volume.size[2] }, data, owner);
+}
+
+// Mapped volumes with uint16 samples are projected in place, without ever converting them to floats
+inline auto compactFromLoadedVolume(const LoadedVolume& volume) -> std::optional< CompactVolume >
+{
+    if (!volume.mapped || volume.mapped->format() == SampleFormat::Float32)
+    {
+        return std::nullopt;
+    }
+    return CompactVolume(volume.mapped, volume.mapped->view());
+}
+
+// `epipolar.read_volumes` for the files a native loader could not read (DICOM, meshes, compressed TIFFs, ...), see
+// `streamVolumesNative`
 template< typename T >
-inline auto importVolumes(const std::string& dirname) -> std::vector< pybind11::array_t< T > >
+inline auto importVolumesPython(const std::string& dirname, const std::vector< std::string >& handledFiles,
+                                bool randomIfEmpty) -> std::vector< pybind11::array_t< T > >
 {
     namespace py = pybind11;
     using namespace pybind11::literals;
-    auto locals = py::dict("dirname"_a = dirname);
 
-    py::exec(R"(
+    std::vector< py::array_t< T > > vec;
+    auto locals = py::dict("dirname"_a = dirname, "skip_files"_a = handledFiles, "random_if_empty"_a = randomIfEmpty);
+    try
+    {
+        py::exec(R"(
 import epipolar
-vols = epipolar.read_volumes(dirname)
+vols = epipolar.read_volumes(dirname, skip_files, random_if_empty)
 num_vols = len(vols)
 				 )",
-             py::globals(), locals);
-    try
-    {
-        std::vector< py::array_t< T > > vec;
+                 py::globals(), locals);
         auto len = locals["num_vols"].cast< int >();
         for (int i = 0; i < len; ++i)
         {
@@ -47,7 +139,7 @@ num_vols = len(vols)
     {
         qCritical() << "Could not open volumes from folder!";
         qCritical() << exp.what();
-        return std::vector< py::array_t< T > >();
+        return vec;
     }
 }
 
@@ -87,69 +179,354 @@ projection, matrix, detector_spacing = epipolar.generate_projections(vol)
     }
 }
 
-template< typename T >
-inline auto importProjections(const std::string& dirname)
-    -> std::pair< std::vector< std::vector< pybind11::array_t< T > > >,
-                  std::vector< std::vector< Geometry::ProjectionMatrix > > >
+inline auto volumeView(const pybind11::array_t< float >& volume, double spacing) -> VolumeView
+{
+    VolumeView view;
+    view.data    = volume.data();
+    view.spacing = spacing;
+    for (int d = 0; d < 3; ++d)
+    {
+        view.size[d]   = volume.shape(d);
+        view.stride[d] = volume.strides(d) / static_cast< int64_t >(sizeof(float));
+    }
+    return view;
+}
+
+// Slice `i` (along the first axis) of `volume` as float image, e.g. dequantized for the display
+inline auto sliceFromView(const VolumeView& volume, int64_t i) -> cv::Mat
+{
+    cv::Mat slice(static_cast< int >(volume.size[1]), static_cast< int >(volume.size[2]), CV_32FC1);
+    for (int64_t j = 0; j < volume.size[1]; ++j)
+    {
+        auto* row = slice.ptr< float >(static_cast< int >(j));
+        for (int64_t k = 0; k < volume.size[2]; ++k)
+        {
+            row[k] = volume.at(i, j, k);
+        }
+    }
+    return slice;
+}
+
+// C-contiguous float copy of `volume` (any layout and sample format), e.g. dequantized samples for Python
+inline auto arrayFromView(const VolumeView& volume) -> pybind11::array_t< float >
+{
+    pybind11::array_t< float > array({ volume.size[0], volume.size[1], volume.size[2] });
+    float* data = array.mutable_data();
+#pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < volume.size[0]; ++i)
+    {
+        for (int64_t j = 0; j < volume.size[1]; ++j)
+        {
+            float* row = data + (i * volume.size[1] + j) * volume.size[2];
+            for (int64_t k = 0; k < volume.size[2]; ++k)
+            {
+                row[k] = volume.at(i, j, k);
+            }
+        }
+    }
+    return array;
+}
+
+// Volumes of a packed dataset, mapped read-only
+inline auto volumesFromPacked(const std::shared_ptr< const PackedDataset >& packed)
+    -> std::vector< pybind11::array_t< float > >
+{
+    std::vector< pybind11::array_t< float > > volumes;
+    for (const auto& entry : packed->entries())
+    {
+        volumes.push_back(arrayFromMapping(packed, entry.array.data, entry.array.size, entry.hash));
+    }
+    return volumes;
+}
+
+// Entries for packing `volumes`, the hashes of mapped volumes are reused. Volumes without float samples (empty arrays)
+// are packed from `compactVolumes` as float32 like all others. Requires the GIL.
+inline auto packedVolumeEntries(const std::vector< pybind11::array_t< float > >& volumes,
+                                const std::vector< std::optional< CompactVolume > >& compactVolumes)
+    -> std::vector< PackedEntry >
+{
+    std::vector< PackedEntry > entries(volumes.size());
+    for (size_t i = 0; i < volumes.size(); ++i)
+    {
+        if (volumes[i].ndim() != 3)
+        {
+            entries[i].array = compactVolumes[i]->view();
+            entries[i].hash  = entries[i].array.id;
+            continue;
+        }
+        const auto* mapped = mappedArrayOf(volumes[i]);
+        entries[i].array   = volumeView(volumes[i], 1.);
+        entries[i].hash    = mapped ? mapped->hash : 0;
+    }
+    return entries;
+}
+
+// Writes a packed dataset of `entries` (see `packedVolumeEntries`, missing hashes are computed) without touching
+// Python objects. Failures are only logged. Stops between volumes and slices once `cancelled` is set, without leaving a
+// file behind.
+inline void packVolumes(const std::string& path, const std::string& cacheDirectory,
+                        const std::vector< SourceStamp >& sources, std::vector< PackedEntry > entries,
+                        const std::atomic< bool >& cancelled)
+{
+    try
+    {
+        for (auto& entry : entries)
+        {
+            if (cancelled)
+            {
+                return;
+            }
+            entry.hash = entry.hash ? entry.hash : contentHash(entry.array);
+        }
+        QDir().mkpath(QString::fromStdString(cacheDirectory));
+        if (!writePackedDataset(path, PackedKind::Volumes, sources, entries, &cancelled))
+        {
+            qInfo() << "Cancelled packing volumes into" << QString::fromStdString(path);
+            return;
+        }
+        qInfo() << "Packed" << entries.size() << "volumes into" << QString::fromStdString(path);
+    } catch (std::exception& exp)
+    {
+        qWarning() << "Could not write packed dataset";
+        qWarning() << exp.what();
+    }
+}
+
+inline auto projectionKey(const VolumeView& volume, const Geometry::ProjectionMatrix& matrix,
+                          const ConeBeamGeometry& geometry, const ProjectorOptions& options) -> ProjectionKey
+{
+    ProjectionKey key;
+    key.volume = volume.id;
+    std::copy(matrix.data(), matrix.data() + 12, key.matrix.begin());
+    key.width              = geometry.detectorWidth;
+    key.height             = geometry.detectorHeight;
+    key.detectorSpacing    = geometry.detectorSpacing;
+    key.volumeSpacing      = volume.spacing;
+    key.engine             = static_cast< int >(options.engine);
+    key.emptySpaceSkipping = volume.occupancy != nullptr;
+    return key;
+}
+
+// Runs a compiled CPU projector for each of `matrices` and normalizes each projection to a maximum of 1 like
+// `epipolar.generate_projections`. `projections` is a stack of `matrices.size()` detector images. The spacing of
+// `volume` is relative to `geometry.volumeSpacing` (> 1 for coarse pyramid levels). Does not touch Python objects, so
+// it can be called from worker threads.
+//
+// Volumes with an id are looked up in/added to `cache` if given, only the missing views are projected (in one batch).
+// If `options.cancelled` is set during the projection, `projections` are left incomplete and nothing is cached.
+inline auto projectNormalizedBatch(VolumeView volume, const std::vector< Geometry::ProjectionMatrix >& matrices,
+                                   const ConeBeamGeometry& geometry, const ProjectorOptions& options,
+                                   float* projections, ProjectionCache* cache = nullptr) -> ProjectorStats
+{
+    volume.spacing *= geometry.volumeSpacing;
+    auto size     = static_cast< size_t >(geometry.detectorWidth) * static_cast< size_t >(geometry.detectorHeight);
+    bool useCache = cache && volume.id;
+
+    std::vector< size_t > missing;
+    std::vector< Geometry::ProjectionMatrix > missingMatrices;
+    for (size_t v = 0; v < matrices.size(); ++v)
+    {
+        if (useCache)
+        {
+            if (auto cached = cache->find(projectionKey(volume, matrices[v], geometry, options)))
+            {
+                std::copy(cached->begin(), cached->end(), projections + v * size);
+                qInfo() << "Forward projection loaded from cache";
+                continue;
+            }
+        }
+        missing.push_back(v);
+        missingMatrices.push_back(matrices[v]);
+    }
+    if (missing.empty())
+    {
+        return ProjectorStats{};
+    }
+
+    // Project directly into `projections` unless some views came from the cache
+    std::vector< float > buffer(missing.size() == matrices.size() ? 0 : missing.size() * size);
+    float* output = buffer.empty() ? projections : buffer.data();
+    auto stats    = forwardProjectBatch(volume, missingMatrices, geometry.detectorSpacing, output,
+                                     geometry.detectorWidth, geometry.detectorHeight, options);
+    if (stats.cancelled)
+    {
+        return stats;
+    }
+    qInfo() << "Forward projection of" << missing.size() << "view(s) took" << stats.seconds * 1000. << "ms ("
+            << stats.raysPerSecond() << "rays/s," << stats.samplesPerSecond() << "samples/s, SIMD level"
+            << static_cast< int >(stats.simd) << "," << stats.busySeconds.size() << "threads"
+            << stats.threadEfficiency() * 100. << "% busy)";
+
+    for (size_t m = 0; m < missing.size(); ++m)
+    {
+        float* projection = projections + missing[m] * size;
+        if (!buffer.empty())
+        {
+            std::copy(output + m * size, output + (m + 1) * size, projection);
+        }
+        auto maximum = size ? *std::max_element(projection, projection + size) : 0.f;
+        if (maximum > 0.f)
+        {
+            std::transform(projection, projection + size, projection, [maximum](float v) { return v / maximum; });
+        }
+        if (useCache)
+        {
+            cache->insert(projectionKey(volume, missingMatrices[m], geometry, options),
+                          std::vector< float >(projection, projection + size));
+        }
+    }
+    return stats;
+}
+
+inline auto projectNormalized(const VolumeView& volume, const Geometry::ProjectionMatrix& matrix,
+                              const ConeBeamGeometry& geometry, const ProjectorOptions& options, float* projection,
+                              ProjectionCache* cache = nullptr) -> ProjectorStats
+{
+    return projectNormalizedBatch(volume, { matrix }, geometry, options, projection, cache);
+}
+
+// Same as `makeProjection` but without Python/CUDA: runs a compiled CPU projector directly on the volume buffer
+// (linear or bricked)
+inline auto makeNativeProjection(const VolumeView& volume, const ConeBeamGeometry& geometry,
+                                 const ProjectorOptions& options, std::mt19937& random,
+                                 ProjectionCache* cache = nullptr)
+    -> std::tuple< pybind11::array_t< float >, Geometry::ProjectionMatrix, float >
+{
+    auto matrix = geometry.randomProjectionMatrix(random);
+
+    pybind11::array_t< float > projection({ geometry.detectorHeight, geometry.detectorWidth });
+    projectNormalized(volume, matrix, geometry, options, projection.mutable_data(), cache);
+    return { projection, matrix, static_cast< float >(geometry.detectorSpacing) };
+}
+
+// `nativeVolume` is the storage of `volume` used by the native backend, e.g. a `BrickedVolume::view()`. It is unused
+// (and may be empty) for the Python backend.
+inline auto makeProjection(const pybind11::array_t< float >& volume, const VolumeView& nativeVolume,
+                           ProjectionBackend backend, const ConeBeamGeometry& geometry, const ProjectorOptions& options,
+                           std::mt19937& random, ProjectionCache* cache = nullptr)
+    -> std::tuple< pybind11::array_t< float >, Geometry::ProjectionMatrix, float >
+{
+    if (backend == ProjectionBackend::Native)
+    {
+        return makeNativeProjection(nativeVolume, geometry, options, random, cache);
+    }
+    return makeProjection< float >(volume);
+}
+
+// Decodes one projection with `epipolar.read_projection`, has to be called with the GIL
+inline auto decodeProjectionPython(const std::string& path) -> cv::Mat
 {
     namespace py = pybind11;
     using namespace pybind11::literals;
-    auto locals = py::dict("dirname"_a = dirname);
+    auto locals = py::dict("path"_a = path);
+    py::exec(R"(
+import epipolar
+projection = epipolar.read_projection(path)
+				 )",
+             py::globals(), locals);
+    return cvMatFromArray(locals["projection"].cast< py::array_t< float > >(), CvMatMode::Copy);
+}
 
+// Decodes a DICOM file that was already read with `epipolar.decode_projection`, has to be called with the GIL
+inline auto decodeProjectionBytesPython(const std::vector< char >& bytes) -> cv::Mat
+{
+    namespace py = pybind11;
+    using namespace pybind11::literals;
+    auto locals = py::dict("data"_a = py::bytes(bytes.data(), bytes.size()));
     py::exec(R"(
 import epipolar
-projections, matrices = epipolar.read_projections(dirname)
-assert len(projections) == len(matrices)
-num_projections = len(projections)
-#print(matrices)
-#print(projections)
+projection = epipolar.decode_projection(data)
 				 )",
              py::globals(), locals);
-    auto vols = [&]() -> std::pair< std::vector< std::vector< pybind11::array_t< T > > >,
-                                    std::vector< std::vector< Geometry::ProjectionMatrix > > > {
-        try
+    return cvMatFromArray(locals["projection"].cast< py::array_t< float > >(), CvMatMode::Copy);
+}
+
+// Native decoder for uncompressed DICOM files, `epipolar.read_projection` for all others. Needs the GIL for those.
+inline auto decodeProjection(const std::string& path) -> cv::Mat
+{
+    try
+    {
+        return readDicomProjection(path);
+    } catch (std::exception& exp)
+    {
+        qDebug() << "Decoding" << QString::fromStdString(path) << "with Python:" << exp.what();
+    }
+    return decodeProjectionPython(path);
+}
+
+// Data sets of the views in a packed dataset, grouped by pumpkin
+inline auto projectionDatasetsFromPacked(const std::shared_ptr< const PackedDataset >& packed)
+    -> std::vector< std::shared_ptr< const ProjectionDataset > >
+{
+    std::vector< std::vector< cv::Mat > > views;
+    std::vector< std::vector< Geometry::ProjectionMatrix > > matrices;
+    for (const auto& entry : packed->entries())
+    {
+        auto group = static_cast< size_t >(entry.group);
+        if (group >= views.size())
         {
-            auto len = locals["num_projections"].cast< int >();
-            qDebug() << "I have " <<  len << " projections";
-            std::vector< std::vector< py::array_t< T > > > vec(len);
-            std::vector< std::vector< Geometry::ProjectionMatrix > > matrices(len);
-            for (int i = 0; i < len; ++i)
-            {
-                locals["i"]             = i;
-                auto num_subprojections = py::eval("len(projections[i])", py::globals(), locals).cast< int >();
-                for (int sub_idx = 0; sub_idx < num_subprojections; ++sub_idx)
-                {
-                    locals["sub_idx"] = sub_idx;
-                    auto projection =
-                        py::eval("projections[i][sub_idx]", py::globals(), locals).cast< py::array_t< T > >();
-                    auto matrix = py::eval("matrices[i][sub_idx]", py::globals(), locals).cast< py::array_t< T > >();
-                    if (matrix.shape()[0] != 3 || matrix.shape()[1] != 4)
-                    {
-                        qCritical() << "Matrix not 3x4!!";
-                        qCritical() << "Shape: " << matrix.shape()[0] << " " << matrix.shape()[1];
-                        throw std::runtime_error("Matrix not 3x4!!" __FILE__);
-                    }
-                    Geometry::ProjectionMatrix eigenMatrix{};
-                    for (int k = 0; k < 3; ++k)
-                    {
-                        for (int l = 0; l < 4; ++l)
-                        {
-                            eigenMatrix(k, l) = static_cast< double >(matrix.at(k, l));
-                        }
-                    }
-
-                    vec[i].push_back(projection);
-                    matrices[i].push_back(eigenMatrix);
-                }
-            }
-            return { vec, matrices };
-        } catch (std::exception& exp)
+            views.resize(group + 1);
+            matrices.resize(group + 1);
+        }
+        views[group].emplace_back(static_cast< int >(entry.array.size[1]), static_cast< int >(entry.array.size[2]),
+                                  CV_32FC1, const_cast< float* >(entry.array.data));
+        matrices[group].push_back(entry.matrix);
+    }
+
+    std::vector< std::shared_ptr< const ProjectionDataset > > datasets;
+    for (size_t i = 0; i < views.size(); ++i)
+    {
+        datasets.push_back(std::make_shared< ProjectionDataset >(std::move(views[i]), std::move(matrices[i]), packed));
+    }
+    return datasets;
+}
+
+// Writes the views of eager `datasets` as packed dataset (group = index of the data set). Failures are only logged.
+// Stops between views and rows once `cancelled` is set, without leaving a file behind.
+inline void packProjectionDatasets(const std::string& path, const std::string& cacheDirectory,
+                                   const std::vector< SourceStamp >& sources,
+                                   const std::vector< std::shared_ptr< const ProjectionDataset > >& datasets,
+                                   const std::atomic< bool >& cancelled)
+{
+    // Compact views are expanded one at a time while writing, so that only one expanded view exists at once
+    std::vector< std::pair< size_t, size_t > > indices; // data set and view of each entry
+    std::vector< PackedEntry > entries;
+    for (size_t i = 0; i < datasets.size(); ++i)
+    {
+        for (size_t n = 0; n < datasets[i]->size(); ++n)
+        {
+            auto size = datasets[i]->viewSize(n);
+            PackedEntry entry;
+            entry.array.size = { 1, size.height, size.width };
+            entry.group      = static_cast< int >(i);
+            entry.matrix     = datasets[i]->matrix(n);
+            entries.push_back(entry);
+            indices.emplace_back(i, n);
+        }
+    }
+    cv::Mat expanded;
+    auto expand = [&](size_t index) {
+        auto [i, n] = indices[index];
+        expanded.release();
+        expanded = datasets[i]->view(n);
+        VolumeView array;
+        array.data   = expanded.ptr< float >();
+        array.size   = { 1, expanded.rows, expanded.cols };
+        array.stride = { 0, static_cast< int64_t >(expanded.step1()), 1 };
+        return array;
+    };
+    try
+    {
+        QDir().mkpath(QString::fromStdString(cacheDirectory));
+        if (!writePackedDataset(path, PackedKind::Projections, sources, entries, expand, &cancelled))
         {
-            qCritical() << "Could not open projections from folder!";
-            qCritical() << exp.what();
-            return { std::vector< std::vector< py::array_t< T > > >(),
-                     std::vector< std::vector< Geometry::ProjectionMatrix > >() };
+            qInfo() << "Cancelled packing projections into" << QString::fromStdString(path);
+            return;
         }
-    }();
-    return vols;
+        qInfo() << "Packed" << entries.size() << "projections into" << QString::fromStdString(path);
+    } catch (std::exception& exp)
+    {
+        qWarning() << "Could not write packed dataset";
+        qWarning() << exp.what();
+    }
 }
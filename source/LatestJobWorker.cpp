@@ -0,0 +1,81 @@
+/*
+ * LatestJobWorker.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "LatestJobWorker.hpp"
+
+#include <QDebug>
+#include <exception>
+
+LatestJobWorker::LatestJobWorker() : m_thread(&LatestJobWorker::work, this) {}
+
+LatestJobWorker::~LatestJobWorker()
+{
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        m_stopping = true;
+        m_pending  = nullptr;
+        m_cancelled.store(true);
+    }
+    m_changed.notify_all();
+    m_thread.join();
+}
+
+void LatestJobWorker::post(Job job)
+{
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        m_pending = std::move(job);
+        m_cancelled.store(true);
+    }
+    m_changed.notify_all();
+}
+
+void LatestJobWorker::requestCancel()
+{
+    std::lock_guard< std::mutex > lock(m_mutex);
+    m_pending = nullptr;
+    m_cancelled.store(true);
+}
+
+void LatestJobWorker::cancel()
+{
+    std::unique_lock< std::mutex > lock(m_mutex);
+    m_pending = nullptr;
+    m_cancelled.store(true);
+    m_changed.wait(lock, [this] { return !m_running; });
+}
+
+void LatestJobWorker::work()
+{
+    std::unique_lock< std::mutex > lock(m_mutex);
+    while (true)
+    {
+        m_changed.wait(lock, [this] { return m_stopping || m_pending; });
+        if (m_stopping)
+        {
+            return;
+        }
+        auto job = std::move(m_pending);
+        m_pending = nullptr;
+        m_cancelled.store(false);
+        m_running = true;
+        lock.unlock();
+
+        try
+        {
+            job(m_cancelled);
+        } catch (std::exception& exp)
+        {
+            qCritical() << "Background job failed!";
+            qCritical() << exp.what();
+        }
+
+        lock.lock();
+        m_running = false;
+        m_changed.notify_all();
+    }
+}
@@ -0,0 +1,48 @@
+/*
+ * LatestJobWorker.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// One long-lived thread that only runs the most recently posted job. Posting a job cancels the running one and
+// replaces a job that has not started yet, so a burst of requests never queues up outdated work.
+class LatestJobWorker
+{
+  public:
+    // Jobs should check `cancelled` regularly and return early once it is set
+    using Job = std::function< void(const std::atomic< bool >& cancelled) >;
+
+    LatestJobWorker();
+    ~LatestJobWorker();
+    LatestJobWorker(const LatestJobWorker&) = delete;
+    LatestJobWorker(LatestJobWorker&&)      = delete;
+    auto operator=(const LatestJobWorker&) -> LatestJobWorker& = delete;
+    auto operator=(LatestJobWorker &&) -> LatestJobWorker& = delete;
+
+    // Never blocks
+    void post(Job job);
+    // Drops the pending job and asks the running one to return, never blocks
+    void requestCancel();
+    // Drops the pending job, cancels the running one and waits until it returned
+    void cancel();
+
+  private:
+    void work();
+
+    Job m_pending;
+    bool m_running  = false;
+    bool m_stopping = false;
+    std::atomic< bool > m_cancelled{ false };
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::thread m_thread;
+};
@@ -5,18 +5,28 @@
 #include <GetSet/GetSetInternal.h>
 #include <QColor>
 #include <QDebug>
+#include <QDir>
+#include <QProgressBar>
+#include <QPushButton>
 #include <QSettings>
+#include <QTimer>
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <opencv2/opencv.hpp>
 #include <qglobal.h>
 #include <qnamespace.h>
 #include <qpalette.h>
+#include <stdexcept>
 
+#include "ConeBeamGeometry.hpp"
 #include "CvPybindInterop.hpp"
 #include "EpipolarCalculations.hpp"
+#include "ForwardProjector.hpp"
 #include "GameState.hpp"
 #include "GetSet/GetSet_impl.hxx"
 #include "ImportVolumes.hpp"
+#include "MappedVolume.hpp"
 #include "ProjectiveGeometry.hxx"
 #include "Scoring.hpp"
 #include "glColors.hpp"
@@ -27,11 +37,63 @@ using namespace std::string_literals;
 using namespace pybind11::literals;
 
 static constexpr double TWO_PI = 2. * M_PI;
+// For round producers that are called directly on the GUI thread
+static const std::atomic< bool > NOT_CANCELLED{ false };
+
+static auto coneBeamGeometryFromSettings() -> ConeBeamGeometry
+{
+    ConeBeamGeometry geometry;
+    geometry.sourceIsocenterDistance = GetSet< double >("Settings/Native Projector/Source Isocenter Distance");
+    geometry.sourceDetectorDistance  = GetSet< double >("Settings/Native Projector/Source Detector Distance");
+    geometry.detectorWidth           = GetSet< int >("Settings/Native Projector/Detector Width");
+    geometry.detectorHeight          = GetSet< int >("Settings/Native Projector/Detector Height");
+    geometry.detectorSpacing         = GetSet< double >("Settings/Native Projector/Detector Spacing");
+    geometry.volumeSpacing           = GetSet< double >("Settings/Native Projector/Volume Spacing");
+    return geometry;
+}
+
+static auto projectorOptionsFromSettings() -> ProjectorOptions
+{
+    ProjectorOptions options;
+    options.engine = static_cast< ProjectorEngine >(GetSet< int >("Settings/Native Projector/Engine").getValue());
+    options.simd   = static_cast< SimdLevel >(GetSet< int >("Settings/Native Projector/SIMD").getValue());
+    return options;
+}
+
+// Packed datasets of imported directories are stored here, empty if disabled
+static auto datasetCacheDirectory() -> std::string
+{
+    if (!GetSet< bool >("Settings/Dataset Cache/Enabled"))
+    {
+        return "";
+    }
+    return GetSet< std::string >("Settings/Dataset Cache/Directory");
+}
+
+// Number of files the importers read at the same time
+static auto importConcurrency() -> int
+{
+    return std::max(GetSet< int >("Settings/Import/Concurrent Reads").getValue(), 1);
+}
+
+static auto randomForwardPoint(const OccupancyGrid* grid, float scale, double volumeSpacing, std::mt19937& random)
+    -> Geometry::RP3Point
+{
+    if (grid)
+    {
+        return grid->randomPoint(random, volumeSpacing);
+    }
+    std::uniform_real_distribution<> dis(-scale, scale);
+    return Geometry::RP3Point{ dis(random), dis(random), dis(random), 1 };
+}
 
 MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui(new Ui::MainWindow), m_random(std::random_device()())
 {
     ui->setupUi(this);
     delete ui->statusbar;
+    finishImport(ui->volumeImportProgress);
+    finishImport(ui->projectionImportProgress);
+    connect(ui->cancelImport, &QPushButton::clicked, this, [this]() { cancelImports(); });
 
     this->setAcceptDrops(true);
     readSettings();
@@ -41,10 +103,35 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui(new Ui::MainWi
         const std::string& key(node.name);
 
         qDebug() << "[" << QString::fromStdString(section) << "]:" << QString::fromStdString(key);
+        if (section == "Settings" || section == "Settings/Native Projector" || section == "Settings/Prefetch" ||
+            section == "Settings/Real Projections/Baseline Angle")
+        {
+            // Prepared rounds are outdated, restarted with the next round
+            m_roundGenerator.stop();
+            m_prefetchedDataset = -1;
+        }
+        if (section == "Settings/Projection Cache" ||
+            (section == "Settings/Real Projections" && key == "Sample Format"))
+        {
+            // Prepared rounds and refinements use the old cache or views decoded in the old format
+            stopBackgroundWork();
+        }
+        if (section == "Settings/Projection Cache" || section == "Settings/Real Projections")
+        {
+            configureProjectionCache();
+        }
         if (key == "Volume Directory")
         {
             openDirectory(QString::fromStdString(GetSet< std::string >("Settings/Volume Directory")));
         }
+        else if (key == "Volume Layout" || (section == "Settings/Native Projector" && key == "Sample Format"))
+        {
+            convertVolumes();
+        }
+        else if (section == "Settings/Mapped Volumes" && key == "Export")
+        {
+            exportMappedVolumes();
+        }
         else if (key == "New Volume" && m_volumes.size())
         {
             if (m_volumes.size())
@@ -58,12 +145,12 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui(new Ui::MainWi
         {
             newForwardProjections();
         }
-        else if (key == "New Pumpkin" && m_projections.size())
+        else if (key == "New Pumpkin" && m_realDatasets.size())
         {
-            if (m_projections.size())
+            if (m_realDatasets.size())
             {
                 m_state.realProjectionsNumber++;
-                m_state.realProjectionsNumber %= m_projections.size();
+                m_state.realProjectionsNumber %= m_realDatasets.size();
                 newRealProjections();
             }
         }
@@ -159,6 +246,49 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui(new Ui::MainWi
     GetSet< float >("Settings/Random Point Range")               = 100.;
     GetSet< float >("Settings/Detector Spacing")                 = .308; // Siemens Artis Zeego or how it's called
     GetSet< bool >("Settings/Siemens Flip for Real Projections") = true;
+    GetSetGui::Enum("Settings/Projection Backend").setChoices("Python (CUDA);Native (CPU)") = 0;
+
+    ConeBeamGeometry defaultGeometry;
+    GetSet< double >("Settings/Native Projector/Source Isocenter Distance") = defaultGeometry.sourceIsocenterDistance;
+    GetSet< double >("Settings/Native Projector/Source Detector Distance")  = defaultGeometry.sourceDetectorDistance;
+    GetSet< int >("Settings/Native Projector/Detector Width")               = defaultGeometry.detectorWidth;
+    GetSet< int >("Settings/Native Projector/Detector Height")              = defaultGeometry.detectorHeight;
+    GetSet< double >("Settings/Native Projector/Detector Spacing")          = defaultGeometry.detectorSpacing;
+    GetSet< double >("Settings/Native Projector/Volume Spacing")            = defaultGeometry.volumeSpacing;
+    GetSetGui::Enum("Settings/Native Projector/Engine")
+        .setChoices("Generated Kernel;Incremental Traversal;Ray Packets (SIMD)") = 2;
+    GetSetGui::Enum("Settings/Native Projector/SIMD").setChoices("Scalar;AVX2;AVX-512;Best Available") = 3;
+    GetSetGui::Enum("Settings/Native Projector/Volume Layout").setChoices("Linear;Bricked (8x8x8)")    = 1;
+    GetSetGui::Enum("Settings/Native Projector/Sample Format").setChoices("Float32;UInt16 (Quantized);Float16") = 0;
+    GetSet< bool >("Settings/Native Projector/Empty Space Skipping")                                   = true;
+    GetSet< bool >("Settings/Random Point Inside Object")                                              = true;
+    GetSet< bool >("Settings/Native Projector/Progressive Refinement") = true;
+    GetSet< double >("Settings/Native Projector/Preview Budget [ms]")  = 30.;
+    GetSet< int >("Settings/Prefetch/Queue Depth")                     = 2;
+    GetSet< int >("Settings/Prefetch/Producer Threads")                = 1;
+    GetSet< bool >("Settings/Projection Cache/Enabled")                = true;
+    GetSet< int >("Settings/Projection Cache/Memory Budget [MiB]")     = 256;
+    GetSet< bool >("Settings/Projection Cache/Disk Cache")             = false;
+    GetSetGui::Directory("Settings/Projection Cache/Directory")        = "projection-cache";
+    GetSetGui::Directory("Settings/Mapped Volumes/Directory")          = "mapped-volumes";
+    GetSet< bool >("Settings/Real Projections/Lazy Loading")           = false;
+    GetSet< int >("Settings/Real Projections/Decoded Cache [MiB]")     = 512;
+    GetSetGui::Enum("Settings/Real Projections/Sample Format").setChoices("Float32;UInt16 (Quantized);Float16") = 0;
+    GetSet< double >("Settings/Real Projections/Baseline Angle/Minimum [deg]") = 0.;
+    GetSet< double >("Settings/Real Projections/Baseline Angle/Maximum [deg]") = 180.;
+    GetSet< bool >("Settings/Dataset Cache/Enabled")                   = true;
+    GetSetGui::Directory("Settings/Dataset Cache/Directory")           = "dataset-cache";
+    GetSet< int >("Settings/Import/Concurrent Reads")                  = DEFAULT_IO_CONCURRENCY;
+    GetSetGui::Enum("Settings/Mapped Volumes/Sample Type").setChoices("Float32;UInt16 (Quantized)") = 0;
+    GetSetGui::Button("Settings/Mapped Volumes/Export") = "Export Loaded Volumes";
+    GetSet< int >("Settings/Native Projector/Sample Format")
+        .setDescription("Samples read by the CPU projector. With the 16 bit formats, volumes are converted when they "
+                        "are used first and their float32 samples are released once the import finished, halving "
+                        "their memory. Python gets dequantized copies. Switching back to Float32 restores the volumes "
+                        "from the 16 bit samples, the quantization error stays until the directory is opened again.");
+    GetSet< int >("Settings/Real Projections/Sample Format")
+        .setDescription("Storage of real projections. The 16 bit formats halve their memory. Lazily decoded views "
+                        "switch immediately, eager imports when the directory is opened again.");
 
     GetSetGui::Slider("Display/P1 Color/red").setMin(0.).setMax(1.) = 1.;
     GetSetGui::Slider("Display/P1 Color/green").setMin(0.).setMax(1.);
@@ -181,6 +311,7 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui(new Ui::MainWi
 
     GetSet<>("ini-File") = "epipolar-game.ini";
     GetSetIO::load< GetSetIO::IniFile >(GetSet<>("ini-File"));
+    configureProjectionCache();
 
     GetSet< int >("Game/Score P1") = 0;
     GetSet< int >("Game/Score P2") = 0;
@@ -192,7 +323,12 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui(new Ui::MainWi
     updateGameLogic();
 }
 
-MainWindow::~MainWindow() { delete ui; }
+MainWindow::~MainWindow()
+{
+    cancelImports();
+    stopBackgroundWork();
+    delete ui;
+}
 
 auto MainWindow::readSettings() -> void
 {
@@ -390,58 +526,704 @@ auto MainWindow::keyPressEvent(QKeyEvent* event) -> void
 
 auto MainWindow::openDirectory(const QString& path) -> void
 {
-    m_volumes = importVolumes< float >(path.toStdString());
-
-    qInfo() << "Loaded " << m_volumes.size() << " volumes";
-    for (auto& v : m_volumes)
+    stopBackgroundWork();
+    m_volumeImport.cancel();
+    m_volumes.clear();
+    m_brickedVolumes.clear();
+    m_compactVolumes.clear();
+    m_occupancyGrids.clear();
+    m_pyramids.clear();
+    m_volumeHashes.clear();
+    m_state.volumeNumber = 0;
+    m_keepFloatVolumes   = false;
+
+    auto dirname        = path.toStdString();
+    auto cacheDirectory = datasetCacheDirectory();
+    auto packPath =
+        cacheDirectory.empty() ? std::string() : packedDatasetPath(cacheDirectory, dirname, PackedKind::Volumes);
+    if (!packPath.empty())
     {
-        qInfo() << "Shape volume: " << v.shape()[0] << ", " << v.shape()[1] << ", " << v.shape()[2];
+        if (auto packed = PackedDataset::open(packPath, dirname, PackedKind::Volumes))
+        {
+            for (auto& volume : volumesFromPacked(packed))
+            {
+                appendVolume(volume);
+            }
+            qInfo() << "Mapped" << m_volumes.size() << "volumes from" << QString::fromStdString(packPath);
+            return;
+        }
     }
 
-    if (m_volumes.size())
+    // Native volumes appear one by one as they are decoded, Python reads the remaining files at the end
+    showImportProgress(ui->volumeImportProgress, 0, 0);
+    m_keepFloatVolumes = true;
+    m_volumeImport.start([this, dirname, cacheDirectory, packPath,
+                          concurrency = importConcurrency()](StreamingImport& import) {
+        auto sources = packPath.empty() ? std::vector< SourceStamp >() : scanSources(dirname);
+        auto native  = streamVolumesNative(
+            dirname, concurrency,
+            [this, &import](LoadedVolume volume) {
+                auto loaded = std::make_shared< LoadedVolume >(std::move(volume));
+                import.post([this, loaded]() {
+                    auto compact = compactFromLoadedVolume(*loaded);
+                    appendVolume(compact ? pybind11::array_t< float >() : arrayFromLoadedVolume(std::move(*loaded)),
+                                 std::move(compact));
+                });
+            },
+            [this, &import](size_t done, size_t total) {
+                import.post([this, done, total]() { showImportProgress(ui->volumeImportProgress, done, total); });
+            },
+            &import.cancelFlag());
+        if (import.cancelled())
+        {
+            return;
+        }
+
+        import.post([this, dirname, cacheDirectory, packPath, sources, handledFiles = native.handledFiles,
+                     unhandled = !native.unhandledFiles.empty()]() {
+            if (unhandled || m_volumes.empty())
+            {
+                for (auto& volume : importVolumesPython< float >(dirname, handledFiles, m_volumes.empty()))
+                {
+                    appendVolume(volume);
+                }
+            }
+            finishImport(ui->volumeImportProgress);
+            qInfo() << "Loaded " << m_volumes.size() << " volumes";
+
+            if (!packPath.empty() && sources.size() > 1 && !m_volumes.empty())
+            {
+                // Points into `m_volumes`, which are only cleared or released after `m_volumeImport` has been
+                // cancelled or has finished
+                auto entries = packedVolumeEntries(m_volumes, m_compactVolumes);
+                m_volumeImport.start([this, packPath, cacheDirectory, sources, entries](StreamingImport& import) {
+                    packVolumes(packPath, cacheDirectory, sources, entries, import.cancelFlag());
+                    import.post([this]() { m_keepFloatVolumes = false; });
+                });
+            }
+            else
+            {
+                m_keepFloatVolumes = false;
+            }
+        });
+    });
+}
+
+// `volume` is empty if there are only the 16 bit samples of `compact`
+auto MainWindow::appendVolume(pybind11::array_t< float > volume, std::optional< CompactVolume > compact) -> void
+{
+    // Round producers and refinements point to the occupancy grids, which move when the vectors grow
+    if (m_occupancyGrids.size() == m_occupancyGrids.capacity())
+    {
+        stopBackgroundWork();
+    }
+    m_volumes.push_back(volume);
+    m_brickedVolumes.emplace_back();
+    m_compactVolumes.push_back(std::move(compact));
+    m_occupancyGrids.emplace_back();
+    m_pyramids.emplace_back();
+    m_volumeHashes.push_back(0);
+
+    auto view = sourceVolumeView(static_cast< int >(m_volumes.size()) - 1);
+    qInfo() << "Shape volume: " << view.size[0] << ", " << view.size[1] << ", " << view.size[2];
+    if (m_volumes.size() == 1)
     {
-        cv::Mat mat = cvMatFromArray(m_volumes[0], 0);
+        cv::Mat mat = hasFloatSamples(0) ? cvMatFromArray(m_volumes[0], 0) : sliceFromView(view, 0);
         ui->leftImg->setImage(mat);
         ui->rightImg->setImage(mat);
     }
 }
 
+auto MainWindow::appendRealDataset(std::shared_ptr< const ProjectionDataset > dataset) -> void
+{
+    qInfo() << "Loaded data set with" << dataset->size() << " projections"
+            << (dataset->lazy() ? "(decoded on demand)" : "");
+    auto geometries = std::make_shared< const GeometryTable >(dataset->matrices(),
+                                                              GetSet< float >("Settings/Detector Spacing").getValue());
+    m_realGantryIndices.push_back(std::make_shared< const GantryIndex >(*geometries));
+    m_realBaselinePairs.emplace_back();
+    m_realEpipolarPairs.push_back(std::make_shared< EpipolarPairTable >(std::move(geometries)));
+    m_realDatasets.push_back(std::move(dataset));
+}
+
+// An empty range (`total` 0) shows a busy indicator until the number of files is known
+auto MainWindow::showImportProgress(QProgressBar* progress, size_t done, size_t total) -> void
+{
+    if (progress->isHidden())
+    {
+        progress->reset();
+        progress->show();
+        ui->cancelImport->show();
+    }
+    // Progress is reported by several reader threads, not necessarily in order
+    progress->setRange(0, static_cast< int >(total));
+    progress->setValue(std::max(progress->value(), static_cast< int >(done)));
+}
+
+auto MainWindow::finishImport(QProgressBar* progress) -> void
+{
+    progress->hide();
+    ui->cancelImport->setVisible(!ui->volumeImportProgress->isHidden() || !ui->projectionImportProgress->isHidden());
+}
+
+// Datasets that were imported so far are kept
+auto MainWindow::cancelImports() -> void
+{
+    m_volumeImport.cancel();
+    m_projectionImport.cancel();
+    m_keepFloatVolumes = false;
+    finishImport(ui->volumeImportProgress);
+    finishImport(ui->projectionImportProgress);
+}
+
+auto MainWindow::convertVolumes() -> void
+{
+    stopBackgroundWork();
+    m_brickedVolumes.clear();
+    m_brickedVolumes.resize(m_volumes.size());
+    // Compact copies are converted by `prepareVolume`, they may hold the only samples of a volume
+}
+
+auto MainWindow::exportMappedVolumes() -> void
+{
+    auto directory = QString::fromStdString(GetSet< std::string >("Settings/Mapped Volumes/Directory"));
+    auto type      = static_cast< MappedSampleType >(GetSet< int >("Settings/Mapped Volumes/Sample Type").getValue());
+    QDir().mkpath(directory);
+    for (size_t i = 0; i < m_volumes.size(); ++i)
+    {
+        auto path = QDir(directory).filePath(QString("volume_%1.epivol").arg(i, 3, 10, QChar('0'))).toStdString();
+        auto view    = sourceVolumeView(static_cast< int >(i));
+        view.spacing = GetSet< double >("Settings/Native Projector/Volume Spacing");
+        try
+        {
+            saveMappedVolume(path, view, type);
+            qInfo() << "Exported volume" << i << "to" << QString::fromStdString(path);
+        } catch (std::exception& exp)
+        {
+            qCritical() << "Could not export volume" << i;
+            qCritical() << exp.what();
+        }
+    }
+}
+
+auto MainWindow::prepareVolume(int volumeNumber) -> void
+{
+    auto index         = static_cast< size_t >(volumeNumber);
+    auto view          = sourceVolumeView(volumeNumber);
+    const auto* mapped = hasFloatSamples(volumeNumber) ? mappedArrayOf(m_volumes[index]) : nullptr;
+
+    if (!m_occupancyGrids[index])
+    {
+        auto& grid  = m_occupancyGrids[index].emplace(view);
+        auto& cells = grid.cells();
+        qInfo() << "Occupied cells: " << grid.occupiedCells() << " of " << cells[0] * cells[1] * cells[2];
+    }
+    if (!m_pyramids[index])
+    {
+        m_pyramids[index].emplace(view);
+    }
+    if (!m_volumeHashes[index])
+    {
+        // Compact views carry the hash of their samples
+        m_volumeHashes[index] = mapped && mapped->hash ? mapped->hash : view.id ? view.id : contentHash(view);
+    }
+    auto format   = static_cast< SampleFormat >(GetSet< int >("Settings/Native Projector/Sample Format").getValue());
+    auto& compact = m_compactVolumes[index];
+    // Mapped uint16 samples are always projected in place, converting them would only add a copy
+    bool borrowed = compact && compact->borrowed();
+    if (!borrowed && format != SampleFormat::Float32)
+    {
+        if (!compact || compact->format() != format)
+        {
+            // From the float samples or, if they were released, from the previous 16 bit copy
+            CompactVolume converted(view, format);
+            compact = std::move(converted);
+            qInfo() << "Converted volume" << volumeNumber << "to 16 bit samples (" << compact->bytes() / (1024 * 1024)
+                    << "MiB)";
+        }
+    }
+    else if (!borrowed)
+    {
+        if (compact && !hasFloatSamples(volumeNumber))
+        {
+            // The dequantized values differ from the original ones, their hash is the one of the compact view
+            m_volumes[index]      = arrayFromView(compact->view());
+            m_volumeHashes[index] = compact->view().id;
+            qInfo() << "Restored float samples of volume" << volumeNumber << "from its 16 bit copy";
+        }
+        compact.reset();
+        if (!mappedArrayOf(m_volumes[index]) && !m_brickedVolumes[index] &&
+            static_cast< VolumeLayout >(GetSet< int >("Settings/Native Projector/Volume Layout").getValue()) ==
+                VolumeLayout::Bricked)
+        {
+            auto& bricked = m_brickedVolumes[index].emplace(volumeView(m_volumes[index], 1.));
+            qInfo() << "Converted volume" << volumeNumber << "to bricked layout (" << bricked.bytes() / (1024 * 1024)
+                    << "MiB)";
+        }
+    }
+    releaseFloatVolumes();
+}
+
+// Drops the float samples of all volumes with a compact copy, mapped arrays only cost address space and are kept
+auto MainWindow::releaseFloatVolumes() -> void
+{
+    if (m_keepFloatVolumes)
+    {
+        return;
+    }
+    for (size_t i = 0; i < m_volumes.size(); ++i)
+    {
+        auto volumeNumber = static_cast< int >(i);
+        if (m_compactVolumes[i] && hasFloatSamples(volumeNumber) && !mappedArrayOf(m_volumes[i]))
+        {
+            m_volumes[i] = pybind11::array_t< float >();
+            qInfo() << "Released float samples of volume" << volumeNumber;
+        }
+    }
+}
+
+auto MainWindow::hasFloatSamples(int volumeNumber) const -> bool
+{
+    return m_volumes[static_cast< size_t >(volumeNumber)].ndim() == 3;
+}
+
+// Float samples if there are any, the compact copy otherwise. The spacing is relative (1).
+auto MainWindow::sourceVolumeView(int volumeNumber) -> VolumeView
+{
+    auto index = static_cast< size_t >(volumeNumber);
+    return hasFloatSamples(volumeNumber) ? volumeView(m_volumes[index], 1.) : m_compactVolumes[index]->view();
+}
+
+// For Python: the float samples or a dequantized copy of the compact samples
+auto MainWindow::volumeArray(int volumeNumber) -> pybind11::array_t< float >
+{
+    auto index = static_cast< size_t >(volumeNumber);
+    return hasFloatSamples(volumeNumber) ? m_volumes[index] : arrayFromView(m_compactVolumes[index]->view());
+}
+
+auto MainWindow::nativeVolumeView(int volumeNumber) -> VolumeView
+{
+    prepareVolume(volumeNumber);
+    auto index = static_cast< size_t >(volumeNumber);
+    auto view  = m_compactVolumes[index]  ? m_compactVolumes[index]->view()
+                 : m_brickedVolumes[index] ? m_brickedVolumes[index]->view()
+                                           : volumeView(m_volumes[index], 1.);
+    if (GetSet< bool >("Settings/Native Projector/Empty Space Skipping"))
+    {
+        view.occupancy = &*m_occupancyGrids[index];
+    }
+    // Compact views have the hash of their dequantized samples, projections of the float volume differ
+    if (!m_compactVolumes[index])
+    {
+        view.id = m_volumeHashes[index];
+    }
+    return view;
+}
+
 auto MainWindow::newForwardProjections() -> void
 {
     qDebug() << "New Projections";
-    if (m_volumes.size())
+    if (auto round = popPrefetchedRound(false))
+    {
+        showRound(*round, false);
+    }
+    else if (m_volumes.size())
     {
         qDebug() << "Projecting";
         auto scale = GetSet< float >("Settings/Random Point Range");
         qDebug() << "Scale :" << scale;
-        std::uniform_real_distribution<> dis(-scale, scale);
 
-        auto [view1, matrix1, detectorSpacing] = makeProjection(m_volumes[m_state.volumeNumber]);
-        m_view1                                = view1;
-        cv::Mat m1                             = cvMatFromArray(m_view1);
-        ui->leftImg->setImage(m1);
+        auto backend  = static_cast< ProjectionBackend >(GetSet< int >("Settings/Projection Backend").getValue());
+        auto geometry = coneBeamGeometryFromSettings();
+        auto options  = projectorOptionsFromSettings();
 
-        auto [view2, matrix2, _detectorSpacing] = makeProjection(m_volumes[m_state.volumeNumber]);
-        m_view2                                 = view2;
-        cv::Mat m2                              = cvMatFromArray(m_view2);
-        ui->rightImg->setImage(m2);
+        Geometry::ProjectionMatrix matrix1;
+        Geometry::ProjectionMatrix matrix2;
+        float detectorSpacing = 0.f;
+        if (backend == ProjectionBackend::Native && GetSet< bool >("Settings/Native Projector/Progressive Refinement"))
+        {
+            matrix1         = geometry.randomProjectionMatrix(m_random);
+            matrix2         = geometry.randomProjectionMatrix(m_random);
+            detectorSpacing = static_cast< float >(geometry.detectorSpacing);
+            projectProgressively(matrix1, matrix2, geometry, options);
+        }
+        else
+        {
+            // Only the native backend needs the prepared storage (pyramid, occupancy grid, bricked/compact copies),
+            // only Python needs float samples
+            auto nativeVolume =
+                backend == ProjectionBackend::Native ? nativeVolumeView(m_state.volumeNumber) : VolumeView{};
+            auto volume =
+                backend == ProjectionBackend::Python ? volumeArray(m_state.volumeNumber) : pybind11::array_t< float >();
+
+            std::tie(m_view1, matrix1, detectorSpacing) =
+                makeProjection(volume, nativeVolume, backend, geometry, options, m_random, projectionCache());
+            cv::Mat m1 = cvMatFromArray(m_view1);
+            ui->leftImg->setImage(m1);
+
+            float _detectorSpacing = 0.f;
+            std::tie(m_view2, matrix2, _detectorSpacing) =
+                makeProjection(volume, nativeVolume, backend, geometry, options, m_random, projectionCache());
+            cv::Mat m2 = cvMatFromArray(m_view2);
+            ui->rightImg->setImage(m2);
+        }
 
-        auto randomPoint = Geometry::RP3Point{ dis(m_random), dis(m_random), dis(m_random), 1 };
+        // Python/CONRAD uses its own volume coordinates, the occupancy grid only matches the native geometry
+        const OccupancyGrid* grid = nullptr;
+        if (backend == ProjectionBackend::Native && GetSet< bool >("Settings/Random Point Inside Object"))
+        {
+            grid = &*m_occupancyGrids[m_state.volumeNumber];
+        }
+        auto randomPoint = randomForwardPoint(grid, scale, geometry.volumeSpacing, m_random);
 
+        Geometry::SourceDetectorGeometry geometry1(matrix1, detectorSpacing);
+        Geometry::SourceDetectorGeometry geometry2(matrix2, detectorSpacing);
         m_state.realProjectionsMode         = false;
-        auto [compareLine, groundTruthLine] = getEpipolarLines(matrix1, matrix2, randomPoint, detectorSpacing);
+        auto [compareLine, groundTruthLine] = getEpipolarLines(geometry1, geometry2, randomPoint);
         if (GetSet< bool >("Display/Draw Epipolar Points"))
         {
-            drawEpipolarPoints(matrix1, matrix2, detectorSpacing, randomPoint);
+            drawEpipolarPoints(geometry1, geometry2, randomPoint);
         }
         m_state.compareLine     = compareLine;
         m_state.groundTruthLine = groundTruthLine;
         m_randomPoint           = randomPoint;
     }
+    if (m_volumes.size())
+    {
+        prefetchRounds(false);
+    }
     m_state.inputState = InputState::InputP1;
     updateGameLogic();
 }
 
+// Shows projections of a coarse pyramid level first and replaces them by full resolution projections computed in the
+// background. The coarse level is the finest one that fits into the preview budget, judged by the duration of the last
+// full projection (a level has 1/8 of the samples of the next finer one).
+auto MainWindow::projectProgressively(const Geometry::ProjectionMatrix& matrix1,
+                                      const Geometry::ProjectionMatrix& matrix2, const ConeBeamGeometry& geometry,
+                                      const ProjectorOptions& options) -> void
+{
+    // The running refinement is outdated, stop it so that the preview does not compete with it for the cores
+    m_refinement.requestCancel();
+    auto generation = ++m_projectionGeneration;
+    auto volume     = nativeVolumeView(m_state.volumeNumber);
+
+    const VolumePyramid& pyramid = *m_pyramids[m_state.volumeNumber];
+    if (pyramid.levels() > 0)
+    {
+        auto budget   = GetSet< double >("Settings/Native Projector/Preview Budget [ms]") / 1000.;
+        int level     = 1;
+        auto estimate = m_fullProjectionSeconds / 8.;
+        while (estimate > budget && level < pyramid.levels())
+        {
+            ++level;
+            estimate /= 8.;
+        }
+
+        auto coarseGeometry = geometry.downscaled(1 << level);
+        auto preview        = [&](const Geometry::ProjectionMatrix& matrix) {
+            cv::Mat coarse(coarseGeometry.detectorHeight, coarseGeometry.detectorWidth, CV_32FC1);
+            projectNormalized(pyramid.level(level), downscaleProjectionMatrix(matrix, 1 << level), coarseGeometry,
+                              options, coarse.ptr< float >());
+            cv::Mat full;
+            cv::resize(coarse, full, cv::Size(coarseGeometry.detectorWidth << level,
+                                              coarseGeometry.detectorHeight << level));
+            return full(cv::Rect(0, 0, geometry.detectorWidth, geometry.detectorHeight)).clone();
+        };
+        cv::Mat m1 = preview(matrix1);
+        ui->leftImg->setImage(m1);
+        cv::Mat m2 = preview(matrix2);
+        ui->rightImg->setImage(m2);
+    }
+
+    // Replaces a refinement that has not started yet and stops the running one at its next tile, so quick clicks never
+    // wait for outdated full resolution projections
+    auto cache = projectionCache();
+    m_refinement.post([this, generation, volume, matrix1, matrix2, geometry, options,
+                       cache](const std::atomic< bool >& cancelled) {
+        auto size               = static_cast< size_t >(geometry.detectorWidth) * geometry.detectorHeight;
+        auto projections        = std::make_shared< std::vector< float > >(2 * size);
+        auto refineOptions      = options;
+        refineOptions.cancelled = &cancelled;
+
+        auto stats =
+            projectNormalizedBatch(volume, { matrix1, matrix2 }, geometry, refineOptions, projections->data(), cache);
+        if (stats.cancelled)
+        {
+            return;
+        }
+
+        QMetaObject::invokeMethod(
+            this,
+            [this, generation, projections, size, geometry, seconds = stats.seconds]() {
+                m_fullProjectionSeconds = 0.5 * seconds;
+                if (generation != m_projectionGeneration)
+                {
+                    return;
+                }
+                m_view1 = pybind11::array_t< float >({ geometry.detectorHeight, geometry.detectorWidth },
+                                                     projections->data());
+                m_view2 = pybind11::array_t< float >({ geometry.detectorHeight, geometry.detectorWidth },
+                                                     projections->data() + size);
+                cv::Mat m1 = cvMatFromArray(m_view1);
+                ui->leftImg->setImage(m1);
+                cv::Mat m2 = cvMatFromArray(m_view2);
+                ui->rightImg->setImage(m2);
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+auto MainWindow::configureProjectionCache() -> void
+{
+    auto budget           = GetSet< int >("Settings/Projection Cache/Memory Budget [MiB]").getValue();
+    std::string directory = GetSet< std::string >("Settings/Projection Cache/Directory");
+    m_projectionCache.setByteBudget(static_cast< size_t >(std::max(budget, 0)) << 20);
+    m_projectionCache.setDirectory(GetSet< bool >("Settings/Projection Cache/Disk Cache") ? directory : "");
+
+    auto decodedBudget = GetSet< int >("Settings/Real Projections/Decoded Cache [MiB]").getValue();
+    m_decodedViews->setByteBudget(static_cast< size_t >(std::max(decodedBudget, 0)) << 20);
+    // Lazy datasets decode their views again in the new format, eager imports keep theirs until they are opened again
+    m_decodedViews->setFormat(
+        static_cast< SampleFormat >(GetSet< int >("Settings/Real Projections/Sample Format").getValue()));
+}
+
+auto MainWindow::projectionCache() -> ProjectionCache*
+{
+    return GetSet< bool >("Settings/Projection Cache/Enabled") ? &m_projectionCache : nullptr;
+}
+
+auto MainWindow::stopBackgroundWork() -> void
+{
+    m_roundGenerator.stop();
+    m_prefetchedDataset = -1;
+    m_idleRound.reset();
+    ++m_idleRoundGeneration;
+    // Refinements point to the prepared volumes, only waits for the tile that is traced right now
+    m_refinement.cancel();
+}
+
+// Only for the native backend, Python can only be used from the GUI thread
+auto MainWindow::forwardRoundProducer() -> RoundGenerator::Producer
+{
+    auto volume   = nativeVolumeView(m_state.volumeNumber);
+    auto geometry = coneBeamGeometryFromSettings();
+    auto options  = projectorOptionsFromSettings();
+    auto scale    = GetSet< float >("Settings/Random Point Range");
+    const OccupancyGrid* grid =
+        GetSet< bool >("Settings/Random Point Inside Object") ? &*m_occupancyGrids[m_state.volumeNumber] : nullptr;
+    auto cache = projectionCache();
+
+    return [volume, geometry, options, scale, grid, cache](std::mt19937& random,
+                                                           const std::atomic< bool >& cancelled) {
+        PreparedRound round;
+        round.matrix1 = geometry.randomProjectionMatrix(random);
+        round.matrix2 = geometry.randomProjectionMatrix(random);
+        // Both views in one batch, stacked on top of each other. `stop` cancels at the next tile.
+        auto roundOptions      = options;
+        roundOptions.cancelled = &cancelled;
+        cv::Mat views(2 * geometry.detectorHeight, geometry.detectorWidth, CV_32FC1);
+        projectNormalizedBatch(volume, { round.matrix1, round.matrix2 }, geometry, roundOptions, views.ptr< float >(),
+                               cache);
+        round.view1 = views.rowRange(0, geometry.detectorHeight);
+        round.view2 = views.rowRange(geometry.detectorHeight, 2 * geometry.detectorHeight);
+
+        round.detectorSpacing = static_cast< float >(geometry.detectorSpacing);
+        round.randomPoint     = randomForwardPoint(grid, scale, geometry.volumeSpacing, random);
+        round.geometry1.emplace(round.matrix1, round.detectorSpacing);
+        round.geometry2.emplace(round.matrix2, round.detectorSpacing);
+        std::tie(round.compareLine, round.groundTruthLine) =
+            getEpipolarLines(*round.geometry1, *round.geometry2, round.randomPoint);
+        return round;
+    };
+}
+
+auto MainWindow::realRoundProducer() -> RoundGenerator::Producer
+{
+    auto dataset = m_realDatasets[m_state.realProjectionsNumber];
+    auto pairs   = realEpipolarPairs(m_state.realProjectionsNumber);
+    auto scale   = GetSet< float >("Settings/Random Point Range");
+
+    // Pairs outside of the baseline range are never drawn. If there are none, any two views are used.
+    auto viewPairs = realBaselinePairs(m_state.realProjectionsNumber);
+
+    // Decoding two views is short, `cancelled` is not checked
+    return [dataset, pairs, scale, viewPairs](std::mt19937& random, const std::atomic< bool >& /*cancelled*/) {
+        if (dataset->size() < 2)
+        {
+            throw std::runtime_error("Pumpkin with less than two projections");
+        }
+        size_t random_idx1 = 0;
+        size_t random_idx2 = 0;
+        if (!viewPairs->empty())
+        {
+            std::tie(random_idx1, random_idx2) = viewPairs->sample(random);
+        }
+        else
+        {
+            // Second view drawn from the others
+            std::uniform_int_distribution< size_t > dis_int(0, dataset->size() - 1);
+            random_idx1 = dis_int(random);
+            random_idx2 = std::uniform_int_distribution< size_t >(0, dataset->size() - 2)(random);
+            random_idx2 += random_idx2 >= random_idx1 ? 1 : 0;
+        }
+
+        PreparedRound round;
+        round.view1           = dataset->view(random_idx1).clone();
+        round.view2           = dataset->view(random_idx2).clone();
+        round.matrix1         = dataset->matrix(random_idx1);
+        round.matrix2         = dataset->matrix(random_idx2);
+        const auto& geometries = pairs->geometries();
+        round.geometry1        = geometries.geometry(random_idx1);
+        round.geometry2        = geometries.geometry(random_idx2);
+        round.detectorSpacing  = static_cast< float >(geometries.detectorSpacing());
+
+        std::uniform_real_distribution<> dis(-scale, scale);
+        round.randomPoint = Geometry::RP3Point{ dis(random), dis(random), dis(random), 1 };
+
+        auto viewPair         = pairs->pair(random_idx1, random_idx2);
+        round.compareLine     = { viewPair.epipole1, geometries.pixelProjection(random_idx1) * round.randomPoint };
+        round.groundTruthLine = { viewPair.epipole2, geometries.pixelProjection(random_idx2) * round.randomPoint };
+        round.compareLine.shift(round.view1.cols * 0.5f, round.view1.rows * 0.5f);
+        round.groundTruthLine.shift(round.view1.cols * 0.5f, round.view1.rows * 0.5f);
+        return round;
+    };
+}
+
+// Built when a pumpkin is appended, only rebuilt for a different detector spacing. Pairs are added by the rounds.
+auto MainWindow::realEpipolarPairs(int dataset) -> std::shared_ptr< EpipolarPairTable >
+{
+    auto detectorSpacing = static_cast< double >(GetSet< float >("Settings/Detector Spacing").getValue());
+    auto& pairs          = m_realEpipolarPairs[dataset];
+    if (pairs->geometries().detectorSpacing() != detectorSpacing)
+    {
+        pairs = std::make_shared< EpipolarPairTable >(
+            std::make_shared< const GeometryTable >(m_realDatasets[dataset]->matrices(), detectorSpacing));
+    }
+    return pairs;
+}
+
+// Built on first use, only rebuilt if "Settings/Real Projections/Baseline Angle" changed, so that producers sample
+// in O(1) without any preparation per round
+auto MainWindow::realBaselinePairs(int dataset) -> std::shared_ptr< const BaselinePairs >
+{
+    auto degrees  = M_PI / 180.;
+    auto minAngle = GetSet< double >("Settings/Real Projections/Baseline Angle/Minimum [deg]") * degrees;
+    auto maxAngle = GetSet< double >("Settings/Real Projections/Baseline Angle/Maximum [deg]") * degrees;
+    auto& cached  = m_realBaselinePairs[dataset];
+    if (!cached.pairs || cached.minAngle != minAngle || cached.maxAngle != maxAngle)
+    {
+        cached.minAngle = minAngle;
+        cached.maxAngle = maxAngle;
+        cached.pairs    = std::make_shared< const BaselinePairs >(
+            m_realGantryIndices[dataset]->pairs(minAngle, maxAngle));
+        if (cached.pairs->empty())
+        {
+            qInfo() << "No views with a baseline angle in the range, using any two views";
+        }
+    }
+    return cached.pairs;
+}
+
+// Keeps "Settings/Prefetch/Queue Depth" rounds of the current volume/pumpkin ready
+auto MainWindow::prefetchRounds(bool realProjections) -> void
+{
+    int dataset = realProjections ? m_state.realProjectionsNumber : m_state.volumeNumber;
+    if (realProjections && !m_realDatasets[dataset]->concurrent())
+    {
+        m_roundGenerator.stop();
+        m_prefetchedDataset = -1;
+        prepareRoundWhenIdle(dataset);
+        return;
+    }
+    // Restarts producers that gave up after repeated errors, rounds are prepared synchronously meanwhile
+    if (m_prefetchedDataset == dataset && m_prefetchedRealProjections == realProjections &&
+        !m_roundGenerator.failed())
+    {
+        return;
+    }
+    m_roundGenerator.stop();
+    m_prefetchedDataset         = dataset;
+    m_prefetchedRealProjections = realProjections;
+
+    auto depth   = GetSet< int >("Settings/Prefetch/Queue Depth").getValue();
+    auto threads = GetSet< int >("Settings/Prefetch/Producer Threads").getValue();
+    if (realProjections && m_realDatasets[dataset]->size() > 1)
+    {
+        m_roundGenerator.start(realRoundProducer(), depth, threads, m_random);
+    }
+    else if (!realProjections &&
+             static_cast< ProjectionBackend >(GetSet< int >("Settings/Projection Backend").getValue()) ==
+                 ProjectionBackend::Native)
+    {
+        m_roundGenerator.start(forwardRoundProducer(), depth, threads, m_random);
+    }
+}
+
+// Decodes the views of the next round (lazy data sets with a Python decoder) after the current round has been shown
+auto MainWindow::prepareRoundWhenIdle(int dataset) -> void
+{
+    m_idleRound.reset();
+    if (m_realDatasets[dataset]->size() < 2)
+    {
+        return;
+    }
+    QTimer::singleShot(0, this, [this, dataset, generation = ++m_idleRoundGeneration]() {
+        if (generation != m_idleRoundGeneration || dataset != m_state.realProjectionsNumber ||
+            dataset >= static_cast< int >(m_realDatasets.size()))
+        {
+            return;
+        }
+        try
+        {
+            m_idleRound        = realRoundProducer()(m_random, NOT_CANCELLED);
+            m_idleRoundDataset = dataset;
+        } catch (std::exception& exp)
+        {
+            qCritical() << "Could not prepare round!";
+            qCritical() << exp.what();
+        }
+    });
+}
+
+auto MainWindow::popPrefetchedRound(bool realProjections) -> std::optional< PreparedRound >
+{
+    int dataset = realProjections ? m_state.realProjectionsNumber : m_state.volumeNumber;
+    if (realProjections && m_idleRound && m_idleRoundDataset == dataset)
+    {
+        auto round = std::move(m_idleRound);
+        m_idleRound.reset();
+        return round;
+    }
+    if (m_prefetchedDataset != dataset || m_prefetchedRealProjections != realProjections)
+    {
+        return std::nullopt;
+    }
+    return m_roundGenerator.tryPop();
+}
+
+auto MainWindow::showRound(const PreparedRound& round, bool realProjections) -> void
+{
+    // A running refinement of a progressive projection would overwrite the views
+    ++m_projectionGeneration;
+
+    m_view1 = pybind11::array_t< float >({ round.view1.rows, round.view1.cols }, round.view1.ptr< float >());
+    m_view2 = pybind11::array_t< float >({ round.view2.rows, round.view2.cols }, round.view2.ptr< float >());
+    cv::Mat m1 = round.view1;
+    ui->leftImg->setImage(m1);
+    cv::Mat m2 = round.view2;
+    ui->rightImg->setImage(m2);
+
+    m_state.realProjectionsMode = realProjections;
+    if (GetSet< bool >("Display/Draw Epipolar Points"))
+    {
+        drawEpipolarPoints(*round.geometry1, *round.geometry2, round.randomPoint);
+    }
+    m_state.compareLine     = round.compareLine;
+    m_state.groundTruthLine = round.groundTruthLine;
+    m_randomPoint           = round.randomPoint;
+}
+
 auto MainWindow::evaluate() -> void
 {
     m_state.nextInputState();
@@ -469,83 +1251,191 @@ auto MainWindow::evaluate() -> void
 
 auto MainWindow::newRealProjections() -> void
 {
-    if (m_projectionMatrices.size() && m_projections.size() &&
-        m_projectionMatrices[m_state.realProjectionsNumber].size())
+    if (m_realDatasets.size() && m_realDatasets[m_state.realProjectionsNumber]->size())
     {
-        assert(m_state.realProjectionsNumber < static_cast< int >(m_projectionMatrices.size()));
-        assert(m_state.realProjectionsNumber < static_cast< int >(m_projections.size()));
+        assert(m_state.realProjectionsNumber < static_cast< int >(m_realDatasets.size()));
 
-        std::uniform_int_distribution<> dis_int(0, m_projectionMatrices[m_state.realProjectionsNumber].size() - 1);
-        int random_idx1 = 0;
-        int random_idx2 = 0;
-        while (random_idx1 == random_idx2)
+        auto round = popPrefetchedRound(true);
+        if (!round)
         {
-            random_idx1 = dis_int(m_random);
-            random_idx2 = dis_int(m_random);
-        }
-        auto view1 = m_projections[m_state.realProjectionsNumber][random_idx1];
-        auto view2 = m_projections[m_state.realProjectionsNumber][random_idx2];
-
-        cv::Mat m1 = cvMatFromArray(view1);
-        ui->leftImg->setImage(m1);
-        cv::Mat m2 = cvMatFromArray(view2);
-        ui->rightImg->setImage(m2);
-
-        const Geometry::ProjectionMatrix& p1 = m_projectionMatrices[m_state.realProjectionsNumber][random_idx1];
-        const Geometry::ProjectionMatrix& p2 = m_projectionMatrices[m_state.realProjectionsNumber][random_idx2];
-
-        auto scale = GetSet< float >("Settings/Random Point Range");
-        std::uniform_real_distribution<> dis(-scale, scale);
-
-        auto randomPoint = Geometry::RP3Point{ dis(m_random), dis(m_random), dis(m_random), 1 };
-
-        float detectorSpacing = GetSet< float >("Settings/Detector Spacing");
-
-        auto [compareLine, groundTruthLine] = getEpipolarLines(p1, p2, randomPoint, detectorSpacing);
-        compareLine.shift(ui->leftImg->img().cols * 0.5f, ui->leftImg->img().rows * 0.5f);
-        groundTruthLine.shift(ui->leftImg->img().cols * 0.5f, ui->leftImg->img().rows * 0.5f);
-
-        m_state.realProjectionsMode = true;
-        if (GetSet< bool >("Display/Draw Epipolar Points"))
-        {
-            drawEpipolarPoints(p1, p2, detectorSpacing, randomPoint);
+            try
+            {
+                round = realRoundProducer()(m_random, NOT_CANCELLED);
+            } catch (std::exception& exp)
+            {
+                qCritical() << "Could not decode projections!";
+                qCritical() << exp.what();
+                return;
+            }
         }
+        showRound(*round, true);
+        prefetchRounds(true);
 
-        m_state.compareLine     = compareLine;
-        m_state.groundTruthLine = groundTruthLine;
-        m_state.inputState      = InputState::InputP1;
-        m_randomPoint           = randomPoint;
-
+        m_state.inputState = InputState::InputP1;
         updateGameLogic();
     }
 }
 
 auto MainWindow::openProjectionsDirectory(const QString& path) -> void
 {
-    auto pathStd                 = path.toStdString();
-    auto [projections, matrices] = importProjections< float >(pathStd);
+    stopBackgroundWork();
+    m_projectionImport.cancel();
+    m_decodedViews->clear();
+    m_realDatasets.clear();
+    m_realEpipolarPairs.clear();
+    m_realGantryIndices.clear();
+    m_realBaselinePairs.clear();
+    m_state.realProjectionsNumber = 0;
 
-    qInfo() << "Loaded " << projections.size() << " projection data sets";
-    for (auto& p : projections)
+    auto lazy           = GetSet< bool >("Settings/Real Projections/Lazy Loading").getValue();
+    auto dirname        = path.toStdString();
+    auto cacheDirectory = datasetCacheDirectory();
+    auto format = static_cast< SampleFormat >(GetSet< int >("Settings/Real Projections/Sample Format").getValue());
+    auto packPath =
+        cacheDirectory.empty() ? std::string() : packedDatasetPath(cacheDirectory, dirname, PackedKind::Projections);
+    if (!packPath.empty())
     {
-        qInfo() << "Loaded data set with" << p.size() << " projections";
-        if (p.size() == 0)
+        if (auto packed = PackedDataset::open(packPath, dirname, PackedKind::Projections))
         {
-            m_projections.clear();
-            m_projectionMatrices.clear();
+            qInfo() << "Mapped" << packed->entries().size() << "projections from" << QString::fromStdString(packPath);
+            for (auto& dataset : projectionDatasetsFromPacked(packed))
+            {
+                appendRealDataset(dataset);
+            }
+            return;
         }
     }
-    m_projections        = projections;
-    m_projectionMatrices = matrices;
 
-    m_state.realProjectionsNumber = 0;
+    // Pumpkins appear one by one. The DICOM files of eager imports are read and decoded here, only files that the
+    // native reader cannot decode are decoded by Python on the GUI thread. At most `inFlight` files wait for it.
+    showImportProgress(ui->projectionImportProgress, 0, 0);
+    m_projectionImport.start([this, dirname, lazy, format, cacheDirectory, packPath, cache = m_decodedViews,
+                              concurrency = importConcurrency()](StreamingImport& import) {
+        auto sources  = lazy || packPath.empty() ? std::vector< SourceStamp >() : scanSources(dirname);
+        auto index    = indexProjections(dirname, concurrency);
+        auto inFlight = static_cast< size_t >(concurrency) * 4;
+        size_t total  = 0;
+        for (auto& pumpkin : index)
+        {
+            total += pumpkin.files.size();
+        }
+
+        size_t done = 0;
+        for (auto& pumpkin : index)
+        {
+            if (import.cancelled())
+            {
+                return;
+            }
+            if (lazy)
+            {
+                done += pumpkin.files.size();
+                // The projections of a pumpkin share their transfer syntax. If the native reader decodes the first one,
+                // round producers can decode views without Python.
+                bool native = true;
+                try
+                {
+                    static_cast< void >(readDicomProjection(pumpkin.files.front()));
+                } catch (std::exception&)
+                {
+                    native = false;
+                }
+                auto dataset = std::make_shared< const ProjectionDataset >(
+                    std::move(pumpkin.files), std::move(pumpkin.matrices),
+                    native ? readDicomProjection : decodeProjection, native, cache);
+                import.post([this, dataset, done, total]() {
+                    appendRealDataset(dataset);
+                    showImportProgress(ui->projectionImportProgress, done, total);
+                });
+                continue;
+            }
+
+            auto views    = std::make_shared< std::vector< cv::Mat > >();
+            auto matrices = std::make_shared< std::vector< Geometry::ProjectionMatrix > >();
+            for (size_t begin = 0; begin < pumpkin.files.size(); begin += inFlight)
+            {
+                auto count = std::min(inFlight, pumpkin.files.size() - begin);
+                std::vector< std::shared_ptr< std::vector< char > > > bytes(count);
+                std::vector< cv::Mat > decoded(count);
+                parallelFor(count, concurrency, [&](size_t i) {
+                    try
+                    {
+                        bytes[i] = std::make_shared< std::vector< char > >(readFileBytes(pumpkin.files[begin + i]));
+                    } catch (std::exception& exp)
+                    {
+                        qDebug() << "Skipping" << QString::fromStdString(pumpkin.files[begin + i]) << ":"
+                                 << exp.what();
+                        return;
+                    }
+                    try
+                    {
+                        decoded[i] = compactProjection(decodeDicomProjection(*bytes[i]), format);
+                        bytes[i].reset();
+                    } catch (std::exception& exp)
+                    {
+                        qDebug() << "Decoding" << QString::fromStdString(pumpkin.files[begin + i]) << "with Python:"
+                                 << exp.what();
+                    }
+                });
+                for (size_t i = 0; i < count; ++i)
+                {
+                    if (!import.acquire(inFlight))
+                    {
+                        return;
+                    }
+                    ++done;
+                    import.post([this, views, matrices, format, data = bytes[i], view = decoded[i],
+                                 file = pumpkin.files[begin + i], matrix = pumpkin.matrices[begin + i], done, total]() {
+                        m_projectionImport.release();
+                        showImportProgress(ui->projectionImportProgress, done, total);
+                        if (!view.empty())
+                        {
+                            views->push_back(view);
+                            matrices->push_back(matrix);
+                            return;
+                        }
+                        if (!data)
+                        {
+                            return;
+                        }
+                        try
+                        {
+                            views->push_back(compactProjection(decodeProjectionBytesPython(*data), format));
+                            matrices->push_back(matrix);
+                        } catch (std::exception& exp)
+                        {
+                            qDebug() << "Skipping" << QString::fromStdString(file) << ":" << exp.what();
+                        }
+                    });
+                }
+            }
+            import.post([this, views, matrices, format]() {
+                if (!views->empty())
+                {
+                    appendRealDataset(std::make_shared< const ProjectionDataset >(
+                        std::move(*views), std::move(*matrices), nullptr, format));
+                }
+            });
+        }
+
+        import.post([this, lazy, cacheDirectory, packPath, sources]() {
+            finishImport(ui->projectionImportProgress);
+            qInfo() << "Loaded " << m_realDatasets.size() << " projection data sets";
+            if (!lazy && !packPath.empty() && !m_realDatasets.empty())
+            {
+                m_projectionImport.start(
+                    [packPath, cacheDirectory, sources, datasets = m_realDatasets](StreamingImport& import) {
+                        packProjectionDatasets(packPath, cacheDirectory, sources, datasets, import.cancelFlag());
+                    });
+            }
+        });
+    });
 }
 
-auto MainWindow::drawEpipolarPoints(const Geometry::ProjectionMatrix& p1, const Geometry::ProjectionMatrix& p2,
-                                    float detectorSpacing, const Geometry::RP3Point& randomPoint) -> void
+auto MainWindow::drawEpipolarPoints(const Geometry::SourceDetectorGeometry& geo1,
+                                    const Geometry::SourceDetectorGeometry& geo2, const Geometry::RP3Point& randomPoint)
+    -> void
 {
-    Geometry::SourceDetectorGeometry geo1(p1, detectorSpacing);
-    Geometry::SourceDetectorGeometry geo2(p2, detectorSpacing);
     auto pointOnDetector1  = Geometry::dehomogenized(geo1.project(randomPoint));
     auto sourceOnDetector1 = Geometry::dehomogenized(geo1.project(geo2.C));
     auto pointOnDetector2  = Geometry::dehomogenized(geo2.project(randomPoint));
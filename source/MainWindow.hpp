@@ -3,13 +3,28 @@
 
 #include <QMainWindow>
 #include <memory>
+#include <optional>
 #include <random>
 #include <vector>
 
+#include "BrickedVolume.hpp"
+#include "CompactVolume.hpp"
+#include "ConeBeamGeometry.hpp"
+#include "EpipolarPairTable.hpp"
 #include "GameState.hpp"
+#include "GantryIndex.hpp"
+#include "LatestJobWorker.hpp"
+#include "OccupancyGrid.hpp"
+#include "ProjectionCache.hpp"
+#include "ProjectionDataset.hpp"
 #include "ProjectiveGeometry.hxx"
+#include "RoundGenerator.hpp"
+#include "StreamingImport.hpp"
+#include "VolumePyramid.hpp"
 #include "python_include.hpp"
 
+class QProgressBar;
+
 namespace Ui
 {
 class MainWindow;
@@ -42,12 +57,39 @@ class MainWindow : public QMainWindow
     std::shared_ptr< class GetSetHandler > m_getSetHandler;
 
     auto readSettings() -> void;
+    auto appendVolume(pybind11::array_t< float > volume, std::optional< CompactVolume > compact = std::nullopt)
+        -> void;
+    auto appendRealDataset(std::shared_ptr< const ProjectionDataset > dataset) -> void;
+    auto showImportProgress(QProgressBar* progress, size_t done, size_t total) -> void;
+    auto finishImport(QProgressBar* progress) -> void;
+    auto cancelImports() -> void;
     auto updateGameLogic() -> void;
     auto newForwardProjections() -> void;
+    auto convertVolumes() -> void;
+    auto exportMappedVolumes() -> void;
+    auto prepareVolume(int volumeNumber) -> void;
+    auto releaseFloatVolumes() -> void;
+    [[nodiscard]] auto hasFloatSamples(int volumeNumber) const -> bool;
+    auto sourceVolumeView(int volumeNumber) -> VolumeView;
+    auto volumeArray(int volumeNumber) -> pybind11::array_t< float >;
+    auto nativeVolumeView(int volumeNumber) -> VolumeView;
+    auto projectProgressively(const Geometry::ProjectionMatrix& matrix1, const Geometry::ProjectionMatrix& matrix2,
+                              const ConeBeamGeometry& geometry, const ProjectorOptions& options) -> void;
+    auto stopBackgroundWork() -> void;
+    auto configureProjectionCache() -> void;
+    auto projectionCache() -> ProjectionCache*;
+    auto forwardRoundProducer() -> RoundGenerator::Producer;
+    auto realRoundProducer() -> RoundGenerator::Producer;
+    auto realEpipolarPairs(int dataset) -> std::shared_ptr< EpipolarPairTable >;
+    auto realBaselinePairs(int dataset) -> std::shared_ptr< const BaselinePairs >;
+    auto prefetchRounds(bool realProjections) -> void;
+    auto prepareRoundWhenIdle(int dataset) -> void;
+    auto popPrefetchedRound(bool realProjections) -> std::optional< PreparedRound >;
+    auto showRound(const PreparedRound& round, bool realProjections) -> void;
     auto newRealProjections() -> void;
     auto evaluate() -> void;
-    auto drawEpipolarPoints(const Geometry::ProjectionMatrix& p1, const Geometry::ProjectionMatrix& p2,
-                            float detectorSpacing, const Geometry::RP3Point& randomPoint) -> void;
+    auto drawEpipolarPoints(const Geometry::SourceDetectorGeometry& geo1, const Geometry::SourceDetectorGeometry& geo2,
+                            const Geometry::RP3Point& randomPoint) -> void;
     inline auto inputP1() -> bool
     {
         return m_state.inputState == InputState::InputP1 || m_state.inputState == InputState::InputBoth;
@@ -59,14 +101,68 @@ class MainWindow : public QMainWindow
 
     GameState m_state;
 
+    // Float samples, empty arrays (see `hasFloatSamples`) for mapped uint16 volumes and once they were released in
+    // favor of `m_compactVolumes`
     std::vector< pybind11::array_t< float > > m_volumes;
-    std::vector< std::vector< pybind11::array_t< float > > > m_projections;
-    std::vector< std::vector< Geometry::ProjectionMatrix > > m_projectionMatrices;
+    // Derived data is built by `prepareVolume` when a volume is used for the first time, so that opening a directory
+    // does not read all (mapped) volumes
+    //
+    // Native copies of `m_volumes` for the CPU projector if "Settings/Native Projector/Volume Layout" is bricked.
+    // Mapped volumes are projected in place.
+    std::vector< std::optional< BrickedVolume > > m_brickedVolumes;
+    // 16 bit copies for the CPU projector if "Settings/Native Projector/Sample Format" is not Float32, replacing the
+    // bricked copies. The float samples are released as soon as the import no longer reads them, halving the memory of
+    // the volumes. Python and the display get dequantized copies. Mapped uint16 volumes are borrowed compact volumes
+    // from the start, independent of the setting.
+    std::vector< std::optional< CompactVolume > > m_compactVolumes;
+    // Set while the import of the opened directory (or packing it) may read `m_volumes`, nothing is released meanwhile
+    bool m_keepFloatVolumes = false;
+    // Min/max macro cells of `m_volumes` for empty space skipping and random points inside the objects
+    std::vector< std::optional< OccupancyGrid > > m_occupancyGrids;
+    std::vector< std::optional< VolumePyramid > > m_pyramids;
+    std::vector< uint64_t > m_volumeHashes; // content hashes as volume ids for `m_projectionCache`, 0 if not known yet
+    // One per pumpkin
+    std::vector< std::shared_ptr< const ProjectionDataset > > m_realDatasets;
+    // Decomposed matrices and view pairs of `m_realDatasets`, rebuilt by `realEpipolarPairs` if
+    // "Settings/Detector Spacing" changed
+    std::vector< std::shared_ptr< EpipolarPairTable > > m_realEpipolarPairs;
+    // Views of `m_realDatasets` sorted by gantry angle for "Settings/Real Projections/Baseline Angle"
+    std::vector< std::shared_ptr< const GantryIndex > > m_realGantryIndices;
+    // Pairs of `m_realGantryIndices` in the range (radians) they were built for, rebuilt by `realBaselinePairs` if the
+    // range changed
+    struct CachedBaselinePairs
+    {
+        double minAngle = 0.;
+        double maxAngle = 0.;
+        std::shared_ptr< const BaselinePairs > pairs;
+    };
+    std::vector< CachedBaselinePairs > m_realBaselinePairs;
+    std::shared_ptr< DecodedViewCache > m_decodedViews = std::make_shared< DecodedViewCache >();
 
     pybind11::array_t< float > m_view1;
     pybind11::array_t< float > m_view2;
     std::mt19937 m_random;
     Geometry::RP3Point m_randomPoint{};
+
+    // Full resolution projections of the progressive mode, only results of the latest generation are shown
+    LatestJobWorker m_refinement;
+    int m_projectionGeneration     = 0;
+    double m_fullProjectionSeconds = 0.;
+
+    // Rounds prepared in the background for the current volume or pumpkin, -1 if not prefetching
+    RoundGenerator m_roundGenerator;
+    int m_prefetchedDataset          = -1;
+    bool m_prefetchedRealProjections = false;
+    // Round of a data set whose decoder needs the GIL, prepared on the GUI thread while it is idle
+    std::optional< PreparedRound > m_idleRound;
+    int m_idleRoundDataset    = -1;
+    int m_idleRoundGeneration = 0;
+
+    ProjectionCache m_projectionCache;
+
+    // Imports of the opened directories, their datasets are appended to `m_volumes`/`m_realDatasets` one by one
+    StreamingImport m_volumeImport{ this };
+    StreamingImport m_projectionImport{ this };
 };
 
 #endif // MAINWINDOW_HPP
@@ -0,0 +1,259 @@
+/*
+ * MappedVolume.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "MappedVolume.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "ProjectionCache.hpp"
+
+namespace
+{
+constexpr char MAGIC[8]        = { 'E', 'P', 'I', 'V', 'O', 'L', '0', '1' };
+constexpr uint32_t PAGE_SIZE   = 4096;
+constexpr double UINT16_LEVELS = 65535.;
+
+struct FileHeader
+{
+    char magic[8];
+    uint32_t payloadOffset;
+    uint32_t sampleType;
+    int64_t size[3];
+    double spacing;
+    float scale;
+    float offset;
+    uint64_t hash;
+};
+static_assert(sizeof(FileHeader) == 64, "FileHeader must match the documented layout");
+
+auto hostIsBigEndian() -> bool
+{
+    const uint16_t one = 1;
+    unsigned char first;
+    std::memcpy(&first, &one, 1);
+    return first == 0;
+}
+
+auto voxelCount(const std::array< int64_t, 3 >& size) -> size_t
+{
+    return static_cast< size_t >(size[0]) * static_cast< size_t >(size[1]) * static_cast< size_t >(size[2]);
+}
+
+auto linearView(const float* data, const std::array< int64_t, 3 >& size, double spacing) -> VolumeView
+{
+    VolumeView view;
+    view.data    = data;
+    view.size    = size;
+    view.stride  = { size[1] * size[2], size[2], 1 };
+    view.spacing = spacing;
+    return view;
+}
+
+void writeAll(QFile& file, const void* data, size_t bytes)
+{
+    if (file.write(static_cast< const char* >(data), static_cast< qint64 >(bytes)) != static_cast< qint64 >(bytes))
+    {
+        throw std::runtime_error("Could not write " + file.fileName().toStdString());
+    }
+}
+} // namespace
+
+MappedVolume::MappedVolume(const std::string& path) : m_path(path), m_file(QString::fromStdString(path))
+{
+    if (hostIsBigEndian())
+    {
+        throw std::runtime_error("Mapped volumes are only supported on little endian hosts");
+    }
+    if (!m_file.open(QIODevice::ReadOnly))
+    {
+        throw std::runtime_error("Could not open " + path);
+    }
+    FileHeader header{};
+    if (m_file.read(reinterpret_cast< char* >(&header), sizeof(header)) != sizeof(header) ||
+        std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+    {
+        throw std::runtime_error("Not a mapped volume: " + path);
+    }
+    auto type = static_cast< MappedSampleType >(header.sampleType);
+    if (type != MappedSampleType::Float32 && type != MappedSampleType::UInt16)
+    {
+        throw std::runtime_error("Unsupported sample type in " + path);
+    }
+    if (header.payloadOffset < sizeof(header) || header.payloadOffset % PAGE_SIZE != 0)
+    {
+        throw std::runtime_error("Invalid payload offset in " + path);
+    }
+    for (int d = 0; d < 3; ++d)
+    {
+        if (header.size[d] <= 0 || header.size[d] > std::numeric_limits< int32_t >::max())
+        {
+            throw std::runtime_error("Invalid size in " + path);
+        }
+        m_size[d] = header.size[d];
+    }
+    m_spacing = header.spacing;
+    m_hash    = header.hash;
+
+    auto count = voxelCount(m_size);
+    auto bytes = count * (type == MappedSampleType::Float32 ? sizeof(float) : sizeof(uint16_t));
+    auto size  = static_cast< uint64_t >(m_file.size());
+    if (size < header.payloadOffset + bytes)
+    {
+        throw std::runtime_error("Truncated mapped volume: " + path);
+    }
+    // The padding sample of uint16 payloads is mapped as well if the file has it
+    auto mapped = bytes;
+    if (type == MappedSampleType::UInt16)
+    {
+        mapped = std::min< uint64_t >(bytes + sizeof(uint16_t), size - header.payloadOffset);
+    }
+    auto* payload = m_file.map(header.payloadOffset, static_cast< qint64 >(mapped));
+    if (!payload)
+    {
+        throw std::runtime_error("Could not map " + path + ": " + m_file.errorString().toStdString());
+    }
+
+    if (type == MappedSampleType::Float32)
+    {
+        m_data = reinterpret_cast< const float* >(payload);
+        return;
+    }
+    m_format  = SampleFormat::UInt16;
+    m_scale   = header.scale;
+    m_offset  = header.offset;
+    m_samples = reinterpret_cast< const uint16_t* >(payload);
+    // Without padding in the file, the page behind the payload may not be mapped
+    if (mapped == bytes && bytes % PAGE_SIZE == 0)
+    {
+        m_padded.assign(m_samples, m_samples + count);
+        m_padded.push_back(0);
+        m_file.unmap(payload);
+        m_samples = m_padded.data();
+    }
+}
+
+auto MappedVolume::view() const -> VolumeView
+{
+    auto view = linearView(m_data, m_size, 1.);
+    if (m_format == SampleFormat::UInt16)
+    {
+        view.format  = SampleFormat::UInt16;
+        view.samples = m_samples;
+        view.scale   = m_scale;
+        view.bias    = m_offset;
+    }
+    view.id = m_hash;
+    return view;
+}
+
+void saveMappedVolume(const std::string& path, const VolumeView& volume, MappedSampleType type)
+{
+    if (hostIsBigEndian())
+    {
+        throw std::runtime_error("Mapped volumes are only supported on little endian hosts");
+    }
+    FileHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.payloadOffset = PAGE_SIZE;
+    header.sampleType    = static_cast< uint32_t >(type);
+    std::copy(volume.size.begin(), volume.size.end(), header.size);
+    header.spacing = volume.spacing;
+    header.scale   = 1.f;
+    header.offset  = 0.f;
+
+    auto rowLength = static_cast< size_t >(volume.size[2]);
+    std::vector< uint16_t > quantized;
+    if (type == MappedSampleType::UInt16)
+    {
+        auto minimum = std::numeric_limits< float >::max();
+        auto maximum = std::numeric_limits< float >::lowest();
+        for (int64_t i = 0; i < volume.size[0]; ++i)
+        {
+            for (int64_t j = 0; j < volume.size[1]; ++j)
+            {
+                for (int64_t k = 0; k < volume.size[2]; ++k)
+                {
+                    minimum = std::min(minimum, volume.at(i, j, k));
+                    maximum = std::max(maximum, volume.at(i, j, k));
+                }
+            }
+        }
+        header.offset = minimum;
+        header.scale  = maximum > minimum ? static_cast< float >((maximum - minimum) / UINT16_LEVELS) : 1.f;
+
+        // The stored hash has to match the dequantized values that are projected later
+        quantized.resize(voxelCount(volume.size));
+        auto dequantized = allocateAlignedFloats(quantized.size());
+        for (int64_t i = 0; i < volume.size[0]; ++i)
+        {
+            for (int64_t j = 0; j < volume.size[1]; ++j)
+            {
+                auto row = static_cast< size_t >(i * volume.size[1] + j) * rowLength;
+                for (int64_t k = 0; k < volume.size[2]; ++k)
+                {
+                    auto level = std::lround((volume.at(i, j, k) - header.offset) / header.scale);
+                    quantized[row + k]   = static_cast< uint16_t >(std::clamp(level, 0L, 65535L));
+                    dequantized[row + k] = header.scale * static_cast< float >(quantized[row + k]) + header.offset;
+                }
+            }
+        }
+        header.hash = contentHash(linearView(dequantized.get(), volume.size, volume.spacing));
+    }
+    else
+    {
+        header.hash = contentHash(volume);
+    }
+
+    // Write to a temporary file first so that a crash never leaves a partial volume behind
+    auto temporary = QString::fromStdString(path) + ".tmp";
+    QFile file(temporary);
+    try
+    {
+        if (!file.open(QIODevice::WriteOnly))
+        {
+            throw std::runtime_error("Could not open " + temporary.toStdString());
+        }
+        writeAll(file, &header, sizeof(header));
+        std::vector< char > padding(header.payloadOffset - sizeof(header), 0);
+        writeAll(file, padding.data(), padding.size());
+        if (type == MappedSampleType::UInt16)
+        {
+            quantized.push_back(0);
+            writeAll(file, quantized.data(), quantized.size() * sizeof(uint16_t));
+        }
+        else
+        {
+            std::vector< float > row(rowLength);
+            for (int64_t i = 0; i < volume.size[0]; ++i)
+            {
+                for (int64_t j = 0; j < volume.size[1]; ++j)
+                {
+                    for (int64_t k = 0; k < volume.size[2]; ++k)
+                    {
+                        row[static_cast< size_t >(k)] = volume.at(i, j, k);
+                    }
+                    writeAll(file, row.data(), row.size() * sizeof(float));
+                }
+            }
+        }
+        file.close();
+    } catch (std::exception&)
+    {
+        file.remove();
+        throw;
+    }
+    QFile::remove(QString::fromStdString(path));
+    if (!QFile::rename(temporary, QString::fromStdString(path)))
+    {
+        throw std::runtime_error("Could not rename " + temporary.toStdString());
+    }
+}
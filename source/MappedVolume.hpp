@@ -0,0 +1,75 @@
+/*
+ * MappedVolume.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <QFile>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ForwardProjector.hpp"
+#include "VolumeLoader.hpp"
+
+// Volume file that is memory mapped instead of read (".epivol"). All values are little endian:
+//
+//   offset  type      content
+//        0  char[8]   magic "EPIVOL01"
+//        8  uint32    payload offset in bytes, a multiple of 4096 so that the payload is page aligned
+//       12  uint32    sample type, 0: float32, 1: uint16
+//       16  int64[3]  size, slowest axis first (like the arrays of `epipolar.read_volumes`)
+//       40  float64   voxel spacing
+//       48  float32   scale    uint16 samples represent `scale * sample + offset`
+//       52  float32   offset
+//       56  uint64    `contentHash` of the volume, 0 if unknown
+//
+// The header is zero padded up to the payload, which is the C-contiguous array of samples. UInt16 payloads are followed
+// by one sample of padding for the 32 bit gathers of the packet engine.
+enum class MappedSampleType : uint32_t { Float32 = 0, UInt16 = 1 };
+
+class MappedVolume
+{
+  public:
+    // Maps `path`, only the header is read. Throws std::runtime_error for broken files.
+    explicit MappedVolume(const std::string& path);
+    MappedVolume(const MappedVolume&) = delete;
+    auto operator=(const MappedVolume&) -> MappedVolume& = delete;
+
+    // Samples are used in place, pages are only read by the OS when they are touched. Uint16 samples become a
+    // SampleFormat::UInt16 view with the stored scale and offset, which the packet engine reads without converting
+    // them. The view has a relative spacing of 1 like the arrays of `importVolumes` and the stored hash as id.
+    [[nodiscard]] auto view() const -> VolumeView;
+    [[nodiscard]] auto format() const -> SampleFormat { return m_format; }
+    // Float32 samples, nullptr for uint16 volumes
+    [[nodiscard]] auto data() const -> const float* { return m_data; }
+    [[nodiscard]] auto size() const -> const std::array< int64_t, 3 >& { return m_size; }
+    [[nodiscard]] auto spacing() const -> double { return m_spacing; }
+    // Stored content hash, 0 if unknown
+    [[nodiscard]] auto hash() const -> uint64_t { return m_hash; }
+    [[nodiscard]] auto path() const -> const std::string& { return m_path; }
+
+  private:
+    std::string m_path;
+    QFile m_file;
+    std::array< int64_t, 3 > m_size{};
+    double m_spacing          = 1.;
+    uint64_t m_hash           = 0;
+    SampleFormat m_format     = SampleFormat::Float32;
+    const float* m_data       = nullptr;
+    const uint16_t* m_samples = nullptr;
+    float m_scale             = 1.f;
+    float m_offset            = 0.f;
+    // Copy of uint16 samples without padding in the file whose payload ends at a page boundary
+    std::vector< uint16_t > m_padded;
+};
+
+// Writes `volume` (any layout) in the mapped format. Float32 volumes store their `contentHash`, so that cached
+// projections are found without reading the samples. UInt16 quantizes linearly between the minimum and maximum.
+// Throws std::runtime_error if the file cannot be written.
+void saveMappedVolume(const std::string& path, const VolumeView& volume,
+                      MappedSampleType type = MappedSampleType::Float32);
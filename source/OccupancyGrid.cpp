@@ -0,0 +1,103 @@
+/*
+ * OccupancyGrid.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "OccupancyGrid.hpp"
+
+OccupancyGrid::OccupancyGrid(const VolumeView& volume, int cellSize, float threshold)
+    : m_size(volume.size), m_cellSize(cellSize)
+{
+    for (int a = 0; a < 3; ++a)
+    {
+        m_cells[a] = (m_size[a] + cellSize - 1) / cellSize;
+    }
+    auto numCells = static_cast< size_t >(m_cells[0] * m_cells[1] * m_cells[2]);
+    m_min.assign(numCells, std::numeric_limits< float >::max());
+    m_max.assign(numCells, std::numeric_limits< float >::lowest());
+    m_occupied.assign(numCells, 0);
+
+#pragma omp parallel for schedule(dynamic)
+    for (int64_t ci = 0; ci < m_cells[0]; ++ci)
+    {
+        for (int64_t cj = 0; cj < m_cells[1]; ++cj)
+        {
+            for (int64_t ck = 0; ck < m_cells[2]; ++ck)
+            {
+                // One voxel border: trilinear samples in this cell also read the neighbors
+                std::array< int64_t, 3 > lower{ ci * cellSize - 1, cj * cellSize - 1, ck * cellSize - 1 };
+                std::array< int64_t, 3 > upper{ (ci + 1) * cellSize + 1, (cj + 1) * cellSize + 1,
+                                                (ck + 1) * cellSize + 1 };
+                for (int a = 0; a < 3; ++a)
+                {
+                    lower[a] = std::max(lower[a], int64_t(0));
+                    upper[a] = std::min(upper[a], m_size[a]);
+                }
+                float minimum = std::numeric_limits< float >::max();
+                float maximum = std::numeric_limits< float >::lowest();
+                for (int64_t i = lower[0]; i < upper[0]; ++i)
+                {
+                    for (int64_t j = lower[1]; j < upper[1]; ++j)
+                    {
+                        for (int64_t k = lower[2]; k < upper[2]; ++k)
+                        {
+                            float v = volume.at(i, j, k);
+                            minimum = std::min(minimum, v);
+                            maximum = std::max(maximum, v);
+                        }
+                    }
+                }
+                auto idx        = index(ci, cj, ck);
+                m_min[idx]      = minimum;
+                m_max[idx]      = maximum;
+                m_occupied[idx] = minimum < -threshold || maximum > threshold;
+            }
+        }
+    }
+
+    for (size_t idx = 0; idx < numCells; ++idx)
+    {
+        if (m_occupied[idx])
+        {
+            m_occupiedCells.push_back(static_cast< int64_t >(idx));
+        }
+    }
+}
+
+auto OccupancyGrid::clipToOccupied(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, double& tMin,
+                                   double& tMax) const -> bool
+{
+    double first = std::numeric_limits< double >::infinity();
+    double last  = -std::numeric_limits< double >::infinity();
+    forEachOccupiedSegment(origin, direction, tMin, tMax, [&](double t0, double t1) {
+        first = std::min(first, t0);
+        last  = std::max(last, t1);
+    });
+    tMin = first;
+    tMax = last;
+    return first < last;
+}
+
+auto OccupancyGrid::randomPoint(std::mt19937& random, double spacing) const -> Geometry::RP3Point
+{
+    if (m_occupiedCells.empty())
+    {
+        return Geometry::RP3Point{ 0., 0., 0., 1. };
+    }
+    std::uniform_int_distribution< size_t > pickCell(0, m_occupiedCells.size() - 1);
+    std::uniform_real_distribution<> uniform(0., 1.);
+
+    int64_t idx = m_occupiedCells[pickCell(random)];
+    std::array< int64_t, 3 > cell{ idx / (m_cells[1] * m_cells[2]), (idx / m_cells[2]) % m_cells[1], idx % m_cells[2] };
+    Geometry::RP3Point point{ 0., 0., 0., 1. };
+    for (int a = 0; a < 3; ++a)
+    {
+        double lower = static_cast< double >(cell[a] * m_cellSize) - 0.5;
+        double upper = static_cast< double >(std::min((cell[a] + 1) * m_cellSize, m_size[a])) - 0.5;
+        double index = lower + uniform(random) * (upper - lower);
+        point[a]     = (index - 0.5 * static_cast< double >(m_size[a])) * spacing;
+    }
+    return point;
+}
@@ -0,0 +1,132 @@
+/*
+ * OccupancyGrid.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "ForwardProjector.hpp"
+#include "ProjectiveGeometry.hxx"
+
+// Coarse grid of min/max values over macro cells of `cellSize`^3 voxels. Cells whose values (including a one voxel
+// border for trilinear interpolation) all lie within [-threshold, threshold] are considered empty.
+//
+// Rays are given in continuous index coordinates like in `forwardProject`: voxel i covers [i - 0.5, i + 0.5).
+class OccupancyGrid
+{
+  public:
+    OccupancyGrid() = default;
+    explicit OccupancyGrid(const VolumeView& volume, int cellSize = 8, float threshold = 0.f);
+
+    [[nodiscard]] auto cells() const -> const std::array< int64_t, 3 >& { return m_cells; }
+    [[nodiscard]] auto cellSize() const -> int { return m_cellSize; }
+    [[nodiscard]] auto minimum(int64_t i, int64_t j, int64_t k) const -> float { return m_min[index(i, j, k)]; }
+    [[nodiscard]] auto maximum(int64_t i, int64_t j, int64_t k) const -> float { return m_max[index(i, j, k)]; }
+    [[nodiscard]] auto occupied(int64_t i, int64_t j, int64_t k) const -> bool { return m_occupied[index(i, j, k)]; }
+    [[nodiscard]] auto occupiedCells() const -> size_t { return m_occupiedCells.size(); }
+
+    // Calls `visit(t0, t1)` for each maximal run of occupied cells along `origin + t * direction`, t in [tMin, tMax]
+    template< typename Visitor >
+    void forEachOccupiedSegment(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, double tMin,
+                                double tMax, Visitor&& visit) const;
+    // Shrinks [tMin, tMax] to the first and last occupied cell, returns false if the ray misses all of them
+    auto clipToOccupied(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, double& tMin,
+                        double& tMax) const -> bool;
+
+    // Uniformly distributed point in a random occupied cell in world coordinates, (0, 0, 0, 1) if there are none
+    auto randomPoint(std::mt19937& random, double spacing) const -> Geometry::RP3Point;
+
+  private:
+    [[nodiscard]] inline auto index(int64_t i, int64_t j, int64_t k) const -> size_t
+    {
+        return static_cast< size_t >((i * m_cells[1] + j) * m_cells[2] + k);
+    }
+
+    std::vector< float > m_min;
+    std::vector< float > m_max;
+    std::vector< uint8_t > m_occupied;
+    std::vector< int64_t > m_occupiedCells; // flat indices for sampling
+    std::array< int64_t, 3 > m_cells{};
+    std::array< int64_t, 3 > m_size{};
+    int m_cellSize = 8;
+};
+
+template< typename Visitor >
+void OccupancyGrid::forEachOccupiedSegment(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction,
+                                           double tMin, double tMax, Visitor&& visit) const
+{
+    constexpr double INF = std::numeric_limits< double >::infinity();
+    std::array< int64_t, 3 > cell{};
+    std::array< int64_t, 3 > step{};
+    std::array< double, 3 > tNext{};
+    std::array< double, 3 > tDelta{};
+
+    for (int a = 0; a < 3; ++a)
+    {
+        double entry = origin[a] + tMin * direction[a];
+        cell[a]      = std::clamp(static_cast< int64_t >(std::floor((entry + 0.5) / m_cellSize)), int64_t(0),
+                             m_cells[a] - 1);
+        if (direction[a] > 0.)
+        {
+            step[a]   = 1;
+            tDelta[a] = m_cellSize / direction[a];
+            tNext[a]  = (static_cast< double >((cell[a] + 1) * m_cellSize) - 0.5 - origin[a]) / direction[a];
+        }
+        else if (direction[a] < 0.)
+        {
+            step[a]   = -1;
+            tDelta[a] = -m_cellSize / direction[a];
+            tNext[a]  = (static_cast< double >(cell[a] * m_cellSize) - 0.5 - origin[a]) / direction[a];
+        }
+        else
+        {
+            tDelta[a] = INF;
+            tNext[a]  = INF;
+        }
+    }
+
+    double t     = tMin;
+    double start = 0.;
+    bool inside  = false;
+    while (t < tMax)
+    {
+        int a       = tNext[0] < tNext[1] ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+        double tEnd = std::min(tNext[a], tMax);
+        if (occupied(cell[0], cell[1], cell[2]))
+        {
+            if (!inside)
+            {
+                start  = t;
+                inside = true;
+            }
+        }
+        else if (inside)
+        {
+            visit(start, t);
+            inside = false;
+        }
+
+        t = tEnd;
+        cell[a] += step[a];
+        if (cell[a] < 0 || cell[a] >= m_cells[a])
+        {
+            break;
+        }
+        tNext[a] += tDelta[a];
+    }
+    if (inside)
+    {
+        visit(start, std::min(t, tMax));
+    }
+}
@@ -0,0 +1,354 @@
+/*
+ * PackedDataset.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "PackedDataset.hpp"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+
+namespace
+{
+constexpr char MAGIC[8]       = { 'E', 'P', 'I', 'P', 'A', 'C', 'K', '1' };
+constexpr uint32_t VERSION    = 1; // increase if the preprocessing of imported arrays changes
+constexpr uint64_t PAGE_SIZE  = 4096;
+constexpr uint64_t FNV_OFFSET = 14695981039346656037ULL;
+constexpr uint64_t FNV_PRIME  = 1099511628211ULL;
+
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t kind;
+    uint64_t sourceCount;
+    uint64_t entryCount;
+    uint64_t sourcesOffset;
+    uint64_t entriesOffset;
+    uint64_t payloadOffset;
+    uint64_t reserved;
+};
+static_assert(sizeof(FileHeader) == 64, "FileHeader must match the documented layout");
+
+struct FileEntry
+{
+    int64_t size[3];
+    uint64_t offset;
+    uint64_t hash;
+    int32_t group;
+    uint32_t reserved;
+    double matrix[12];
+};
+static_assert(sizeof(FileEntry) == 144, "FileEntry must match the documented layout");
+
+struct FileSource
+{
+    int64_t size;
+    int64_t modifiedMsec;
+    uint32_t pathBytes;
+};
+
+auto hostIsBigEndian() -> bool
+{
+    const uint16_t one = 1;
+    unsigned char first;
+    std::memcpy(&first, &one, 1);
+    return first == 0;
+}
+
+auto stamp(const QFileInfo& info) -> SourceStamp
+{
+    SourceStamp source;
+    source.path         = info.absoluteFilePath().toStdString();
+    source.size         = info.isDir() ? 0 : static_cast< int64_t >(info.size());
+    source.modifiedMsec = info.lastModified().toMSecsSinceEpoch();
+    return source;
+}
+
+auto voxelCount(const int64_t size[3]) -> uint64_t
+{
+    return static_cast< uint64_t >(size[0]) * static_cast< uint64_t >(size[1]) * static_cast< uint64_t >(size[2]);
+}
+
+auto pageAligned(uint64_t offset) -> uint64_t
+{
+    return (offset + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+}
+
+template< typename T >
+auto readValue(QFile& file, T& value) -> bool
+{
+    return file.read(reinterpret_cast< char* >(&value), sizeof(T)) == static_cast< qint64 >(sizeof(T));
+}
+
+void writeAll(QFile& file, const void* data, size_t bytes)
+{
+    if (file.write(static_cast< const char* >(data), static_cast< qint64 >(bytes)) != static_cast< qint64 >(bytes))
+    {
+        throw std::runtime_error("Could not write " + file.fileName().toStdString());
+    }
+}
+} // namespace
+
+auto SourceStamp::operator==(const SourceStamp& other) const -> bool
+{
+    return path == other.path && size == other.size && modifiedMsec == other.modifiedMsec;
+}
+
+auto scanSources(const std::string& dirname) -> std::vector< SourceStamp >
+{
+    std::vector< SourceStamp > sources{ stamp(QFileInfo(QString::fromStdString(dirname))) };
+    QDirIterator it(QString::fromStdString(dirname), QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext())
+    {
+        it.next();
+        sources.push_back(stamp(it.fileInfo()));
+    }
+    std::sort(sources.begin() + 1, sources.end(),
+              [](const SourceStamp& a, const SourceStamp& b) { return a.path < b.path; });
+    return sources;
+}
+
+PackedDataset::PackedDataset(const std::string& path) : m_file(QString::fromStdString(path))
+{
+}
+
+auto PackedDataset::open(const std::string& path, const std::string& dirname, PackedKind kind)
+    -> std::shared_ptr< const PackedDataset >
+{
+    if (hostIsBigEndian() || !QFileInfo(QString::fromStdString(path)).exists())
+    {
+        return nullptr;
+    }
+    std::shared_ptr< PackedDataset > dataset(new PackedDataset(path));
+    auto& file = dataset->m_file;
+    FileHeader header{};
+    if (!file.open(QIODevice::ReadOnly) || !readValue(file, header) ||
+        std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        header.kind != static_cast< uint32_t >(kind) || header.sourceCount == 0 ||
+        header.payloadOffset % PAGE_SIZE != 0 || !file.seek(static_cast< qint64 >(header.sourcesOffset)))
+    {
+        return nullptr;
+    }
+
+    // The first source is `dirname` itself, the others are checked without listing the directory again
+    for (uint64_t i = 0; i < header.sourceCount; ++i)
+    {
+        FileSource recorded{};
+        if (!readValue(file, recorded.size) || !readValue(file, recorded.modifiedMsec) ||
+            !readValue(file, recorded.pathBytes))
+        {
+            return nullptr;
+        }
+        SourceStamp source;
+        source.path.resize(recorded.pathBytes);
+        if (file.read(&source.path[0], recorded.pathBytes) != static_cast< qint64 >(recorded.pathBytes))
+        {
+            return nullptr;
+        }
+        source.size         = recorded.size;
+        source.modifiedMsec = recorded.modifiedMsec;
+
+        QFileInfo info(QString::fromStdString(i == 0 ? dirname : source.path));
+        if (!info.exists() || !(stamp(info) == source))
+        {
+            qInfo() << "Packed dataset" << QString::fromStdString(path) << "is outdated:"
+                    << QString::fromStdString(source.path);
+            return nullptr;
+        }
+    }
+
+    std::vector< FileEntry > entries(header.entryCount);
+    if (!file.seek(static_cast< qint64 >(header.entriesOffset)) ||
+        file.read(reinterpret_cast< char* >(entries.data()),
+                  static_cast< qint64 >(entries.size() * sizeof(FileEntry))) !=
+            static_cast< qint64 >(entries.size() * sizeof(FileEntry)))
+    {
+        return nullptr;
+    }
+    uint64_t end = header.payloadOffset;
+    for (auto& entry : entries)
+    {
+        if (entry.offset < header.payloadOffset || entry.size[0] <= 0 || entry.size[1] <= 0 || entry.size[2] <= 0)
+        {
+            return nullptr;
+        }
+        end = std::max(end, entry.offset + voxelCount(entry.size) * sizeof(float));
+    }
+    if (static_cast< uint64_t >(file.size()) < end)
+    {
+        return nullptr;
+    }
+
+    const uchar* payload = nullptr;
+    if (end > header.payloadOffset)
+    {
+        payload =
+            file.map(static_cast< qint64 >(header.payloadOffset), static_cast< qint64 >(end - header.payloadOffset));
+        if (!payload)
+        {
+            return nullptr;
+        }
+    }
+    for (auto& entry : entries)
+    {
+        PackedEntry packed;
+        packed.array.data    = reinterpret_cast< const float* >(payload + (entry.offset - header.payloadOffset));
+        packed.array.size    = { entry.size[0], entry.size[1], entry.size[2] };
+        packed.array.stride  = { entry.size[1] * entry.size[2], entry.size[2], 1 };
+        packed.array.id      = entry.hash;
+        packed.hash          = entry.hash;
+        packed.group         = entry.group;
+        for (int k = 0; k < 3; ++k)
+        {
+            for (int l = 0; l < 4; ++l)
+            {
+                packed.matrix(k, l) = entry.matrix[4 * k + l];
+            }
+        }
+        dataset->m_entries.push_back(packed);
+    }
+    return dataset;
+}
+
+auto packedDatasetPath(const std::string& cacheDirectory, const std::string& dirname, PackedKind kind) -> std::string
+{
+    auto absolute = QFileInfo(QString::fromStdString(dirname)).absoluteFilePath().toStdString();
+    uint64_t h    = FNV_OFFSET;
+    for (unsigned char c : absolute)
+    {
+        h = (h ^ c) * FNV_PRIME;
+    }
+    auto name = QString::number(h, 16).rightJustified(16, '0').toStdString();
+    return cacheDirectory + "/" + name + (kind == PackedKind::Volumes ? ".volumes" : ".projections") + ".epipack";
+}
+
+auto writePackedDataset(const std::string& path, PackedKind kind, const std::vector< SourceStamp >& sources,
+                        const std::vector< PackedEntry >& entries, const std::atomic< bool >* cancelled) -> bool
+{
+    return writePackedDataset(
+        path, kind, sources, entries, [&](size_t index) { return entries[index].array; }, cancelled);
+}
+
+auto writePackedDataset(const std::string& path, PackedKind kind, const std::vector< SourceStamp >& sources,
+                        const std::vector< PackedEntry >& entries, const PackedArraySource& arrays,
+                        const std::atomic< bool >* cancelled) -> bool
+{
+    if (hostIsBigEndian())
+    {
+        throw std::runtime_error("Packed datasets are only supported on little endian hosts");
+    }
+    FileHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version       = VERSION;
+    header.kind          = static_cast< uint32_t >(kind);
+    header.sourceCount   = sources.size();
+    header.entryCount    = entries.size();
+    header.sourcesOffset = sizeof(FileHeader);
+
+    uint64_t sourcesBytes = 0;
+    for (auto& source : sources)
+    {
+        sourcesBytes += sizeof(int64_t) + sizeof(int64_t) + sizeof(uint32_t) + source.path.size();
+    }
+    header.entriesOffset = header.sourcesOffset + sourcesBytes;
+    header.payloadOffset = pageAligned(header.entriesOffset + entries.size() * sizeof(FileEntry));
+
+    std::vector< FileEntry > table(entries.size());
+    uint64_t offset = header.payloadOffset;
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        auto& entry = table[i];
+        std::copy(entries[i].array.size.begin(), entries[i].array.size.end(), entry.size);
+        entry.offset = offset;
+        entry.hash   = entries[i].hash;
+        entry.group  = entries[i].group;
+        for (int k = 0; k < 3; ++k)
+        {
+            for (int l = 0; l < 4; ++l)
+            {
+                entry.matrix[4 * k + l] = entries[i].matrix(k, l);
+            }
+        }
+        offset = pageAligned(offset + voxelCount(entry.size) * sizeof(float));
+    }
+
+    // Write to a temporary file first so that a crash never leaves a partial dataset behind
+    auto temporary = QString::fromStdString(path) + ".tmp";
+    QFile file(temporary);
+    try
+    {
+        if (!file.open(QIODevice::WriteOnly))
+        {
+            throw std::runtime_error("Could not open " + temporary.toStdString());
+        }
+        writeAll(file, &header, sizeof(header));
+        for (auto& source : sources)
+        {
+            auto pathBytes = static_cast< uint32_t >(source.path.size());
+            writeAll(file, &source.size, sizeof(source.size));
+            writeAll(file, &source.modifiedMsec, sizeof(source.modifiedMsec));
+            writeAll(file, &pathBytes, sizeof(pathBytes));
+            writeAll(file, source.path.data(), source.path.size());
+        }
+        writeAll(file, table.data(), table.size() * sizeof(FileEntry));
+
+        uint64_t position = header.entriesOffset + table.size() * sizeof(FileEntry);
+        std::vector< char > padding(PAGE_SIZE, 0);
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            writeAll(file, padding.data(), table[i].offset - position);
+            if (cancelled && cancelled->load())
+            {
+                file.close();
+                file.remove();
+                return false;
+            }
+            const auto array = arrays(i);
+            if (!std::equal(array.size.begin(), array.size.end(), table[i].size))
+            {
+                throw std::runtime_error("Array does not match the size of its entry");
+            }
+            std::vector< float > row(static_cast< size_t >(array.size[2]));
+            for (int64_t a = 0; a < array.size[0]; ++a)
+            {
+                if (cancelled && cancelled->load())
+                {
+                    file.close();
+                    file.remove();
+                    return false;
+                }
+                for (int64_t b = 0; b < array.size[1]; ++b)
+                {
+                    for (int64_t c = 0; c < array.size[2]; ++c)
+                    {
+                        row[static_cast< size_t >(c)] = array.at(a, b, c);
+                    }
+                    writeAll(file, row.data(), row.size() * sizeof(float));
+                }
+            }
+            position = table[i].offset + voxelCount(table[i].size) * sizeof(float);
+        }
+        file.close();
+    } catch (std::exception&)
+    {
+        file.remove();
+        throw;
+    }
+    QFile::remove(QString::fromStdString(path));
+    if (!QFile::rename(temporary, QString::fromStdString(path)))
+    {
+        throw std::runtime_error("Could not rename " + temporary.toStdString());
+    }
+    return true;
+}
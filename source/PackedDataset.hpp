@@ -0,0 +1,95 @@
+/*
+ * PackedDataset.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <QFile>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ForwardProjector.hpp"
+#include "ProjectiveGeometry.hxx"
+
+// Everything imported from one directory (volumes or the projections of all pumpkins) as preprocessed float32 arrays
+// in one file that is memory mapped on later launches. All values are little endian:
+//
+//   header     64 bytes   magic "EPIPACK1", format version, kind, number of sources and entries, section offsets
+//   sources               size, mtime and path of each file and directory of the imported directory
+//   entries   144 bytes   size (int64[3]), payload offset, content hash, group (pumpkin), 3x4 matrix (float64,
+//                         row-major) of each array
+//   payloads              C-contiguous float32 arrays, each starting at a page boundary
+//
+// A packed dataset is invalid as soon as one of the recorded sources changed, was removed or a file was added (which
+// changes the mtime of its directory).
+enum class PackedKind : uint32_t { Volumes = 0, Projections = 1 };
+
+// Size and modification time of a file or directory
+struct SourceStamp
+{
+    std::string path;
+    int64_t size         = 0;
+    int64_t modifiedMsec = 0;
+
+    [[nodiscard]] auto operator==(const SourceStamp& other) const -> bool;
+};
+
+// Stamps of `dirname` and all files and directories below it, sorted by path
+auto scanSources(const std::string& dirname) -> std::vector< SourceStamp >;
+
+// One array of a packed dataset. Volumes have a hash, projections belong to a group and have a matrix.
+struct PackedEntry
+{
+    VolumeView array; // projections have a size of 1 along the first axis
+    uint64_t hash = 0;
+    int group     = 0;
+    Geometry::ProjectionMatrix matrix = Geometry::ProjectionMatrix::Zero();
+};
+
+class PackedDataset
+{
+  public:
+    // Maps `path` if it is a packed dataset of `kind` for `dirname` whose sources are unchanged, nullptr otherwise.
+    // Only the header, the sources and the entry table are read.
+    static auto open(const std::string& path, const std::string& dirname, PackedKind kind)
+        -> std::shared_ptr< const PackedDataset >;
+
+    PackedDataset(const PackedDataset&) = delete;
+    auto operator=(const PackedDataset&) -> PackedDataset& = delete;
+
+    // `array.data` points into the mapping, which lives as long as the dataset
+    [[nodiscard]] auto entries() const -> const std::vector< PackedEntry >& { return m_entries; }
+
+  private:
+    explicit PackedDataset(const std::string& path);
+
+    QFile m_file;
+    std::vector< PackedEntry > m_entries;
+};
+
+// File of the packed dataset of `dirname` in `cacheDirectory`
+auto packedDatasetPath(const std::string& cacheDirectory, const std::string& dirname, PackedKind kind) -> std::string;
+
+// Writes `entries` (any layout) as packed dataset. `sources` should be scanned before the import, so that files that
+// change during the import invalidate the result. Throws std::runtime_error if the file cannot be written. Returns
+// false without leaving a file behind if `cancelled` is set while writing (checked between slices).
+auto writePackedDataset(const std::string& path, PackedKind kind, const std::vector< SourceStamp >& sources,
+                        const std::vector< PackedEntry >& entries, const std::atomic< bool >* cancelled = nullptr)
+    -> bool;
+
+// Returns the array of entry `index`, which only has to stay valid until the next call
+using PackedArraySource = std::function< VolumeView(size_t index) >;
+
+// Like above, but the arrays are requested one at a time from `arrays` while writing, so that arrays that are
+// expanded on demand never have to exist all at once. Only the size of `entries[i].array` is used.
+auto writePackedDataset(const std::string& path, PackedKind kind, const std::vector< SourceStamp >& sources,
+                        const std::vector< PackedEntry >& entries, const PackedArraySource& arrays,
+                        const std::atomic< bool >* cancelled = nullptr) -> bool;
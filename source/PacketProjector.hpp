@@ -0,0 +1,230 @@
+/*
+ * PacketProjector.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "SampleFormat.hpp"
+
+// Single precision parameters for tracing packets of adjacent detector rays, all in continuous index coordinates of
+// the volume (see `RaySetup` in ForwardProjector.cpp)
+struct PacketSetup
+{
+    float source[3];
+    float direction0[3];
+    float directionX[3];
+    float directionY[3];
+    float upper[3];     // size - 0.5
+    int32_t last[3];    // size - 1
+    int32_t stride[3];  // in elements, offsets must fit into 32 bit for the gathers
+    const int32_t* offsets[3]; // per-axis offset tables of bricked volumes, nullptr for linear volumes
+    float worldScale;
+    const float* volume;
+    // 16 bit samples instead of `volume` (see CompactVolume), padded by one sample for the 32 bit gathers
+    SampleFormat format;
+    const uint16_t* samples;
+    float scale; // UInt16: value = scale * sample + bias
+    float bias;
+    float* projection;
+    int width;
+    int height;
+    // Optional per-ray parameter range of occupied cells (empty space skipping) for the tile that is traced, starting
+    // at its first pixel with rows padded to `rayPitch`
+    const float* rayStart;
+    const float* rayEnd;
+    int rayPitch;
+
+    static constexpr int PITCH_ALIGNMENT = 16; // widest packet
+};
+
+// Half-open pixel range [x0, x1) x [y0, y1) of the detector
+struct DetectorTile
+{
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+};
+
+// Implemented in translation units compiled for the respective instruction set.
+// Return false if the compiler could not generate code for it.
+auto projectPacketsAvx2(const PacketSetup& setup, const DetectorTile& tile, int64_t& samples) -> bool;
+auto projectPacketsAvx512(const PacketSetup& setup, const DetectorTile& tile, int64_t& samples) -> bool;
+
+// Traces the rays of `tile`, `Simd::WIDTH` neighboring rays of a detector row at once: equidistant samples (about one
+// per voxel) with trilinear interpolation from gathered voxels. Lanes finish independently by masking out samples
+// beyond their exit.
+//
+// Only uses operations of `Simd` so that this can be instantiated in translation units with different target flags.
+// `LINEAR` computes voxel offsets from strides, otherwise they are gathered from the offset tables. 16 bit samples are
+// converted after the gather, UInt16 levels are interpolated and summed as they are and dequantized once per ray.
+template< typename Simd, bool LINEAR, SampleFormat FORMAT >
+auto projectPacketTile(const PacketSetup& s, const DetectorTile& tile) -> int64_t
+{
+    using F                = typename Simd::Float;
+    using I                = typename Simd::Int;
+    using M                = typename Simd::Mask;
+    constexpr int W        = Simd::WIDTH;
+    constexpr float FAR    = 1e30f;
+    const F zero           = Simd::set(0.f);
+    const F one            = Simd::set(1.f);
+    const I zeroI          = Simd::seti(0);
+    const I oneI           = Simd::seti(1);
+    const F endF           = Simd::set(static_cast< float >(tile.x1));
+    int64_t samples        = 0;
+
+    auto voxel = [&s](I offsets, M active) -> F {
+        if constexpr (FORMAT == SampleFormat::Float32)
+        {
+            return Simd::gather(s.volume, offsets, active);
+        }
+        else if constexpr (FORMAT == SampleFormat::UInt16)
+        {
+            return Simd::toFloat(Simd::gatheru16(s.samples, offsets, active));
+        }
+        else
+        {
+            return Simd::halfToFloat(Simd::gatheru16(s.samples, offsets, active));
+        }
+    };
+
+    for (int y = tile.y0; y < tile.y1; ++y)
+    {
+        float* row = s.projection + static_cast< int64_t >(y) * s.width;
+        const F fy = Simd::set(static_cast< float >(y));
+        for (int x0 = tile.x0; x0 < tile.x1; x0 += W)
+        {
+            F x     = Simd::add(Simd::set(static_cast< float >(x0)), Simd::iota());
+            M valid = Simd::less(x, endF);
+
+            // Intersection with the volume box
+            F d[3];
+            F tMin = zero;
+            F tMax = Simd::set(FAR);
+            for (int a = 0; a < 3; ++a)
+            {
+                d[a] = Simd::fmadd(x, Simd::set(s.directionX[a]),
+                                   Simd::fmadd(fy, Simd::set(s.directionY[a]), Simd::set(s.direction0[a])));
+                F inv = Simd::div(one, d[a]);
+                F t0  = Simd::mul(Simd::set(-0.5f - s.source[a]), inv);
+                F t1  = Simd::mul(Simd::set(s.upper[a] - s.source[a]), inv);
+                tMin  = Simd::max(tMin, Simd::min(t0, t1));
+                tMax  = Simd::min(tMax, Simd::max(t0, t1));
+            }
+            if (s.rayStart)
+            {
+                int64_t offset = static_cast< int64_t >(y - tile.y0) * s.rayPitch + (x0 - tile.x0);
+                tMin           = Simd::max(tMin, Simd::load(s.rayStart + offset));
+                tMax           = Simd::min(tMax, Simd::load(s.rayEnd + offset));
+            }
+            // Empty range for missed lanes, so that their (masked) sample positions stay finite
+            M hit    = Simd::land(valid, Simd::less(tMin, tMax));
+            tMin     = Simd::select(hit, tMin, zero);
+            tMax     = Simd::select(hit, tMax, zero);
+            F norm   = Simd::sqrt(Simd::fmadd(d[0], d[0], Simd::fmadd(d[1], d[1], Simd::mul(d[2], d[2]))));
+            F length = Simd::mul(Simd::sub(tMax, tMin), norm);
+
+            // Midpoint rule with ceil(length) samples
+            F numSteps = Simd::ceil(length);
+            F stepT    = Simd::div(Simd::sub(tMax, tMin), Simd::max(numSteps, one));
+            F start    = Simd::fmadd(Simd::set(0.5f), stepT, tMin);
+            F pos0[3];
+            F delta[3];
+            for (int a = 0; a < 3; ++a)
+            {
+                pos0[a]  = Simd::fmadd(start, d[a], Simd::set(s.source[a]));
+                delta[a] = Simd::mul(stepT, d[a]);
+            }
+
+            F sum = zero;
+            F i   = zero;
+            for (M active = Simd::less(i, numSteps); Simd::any(active);
+                 i = Simd::add(i, one), active = Simd::less(i, numSteps))
+            {
+                I lo[3];
+                I hi[3];
+                F frac[3];
+                for (int a = 0; a < 3; ++a)
+                {
+                    F p      = Simd::fmadd(i, delta[a], pos0[a]);
+                    F fl     = Simd::floor(p);
+                    frac[a]  = Simd::sub(p, fl);
+                    I idx    = Simd::toInt(fl);
+                    I last   = Simd::seti(s.last[a]);
+                    I idxLo  = Simd::clampi(idx, zeroI, last);
+                    I idxHi  = Simd::clampi(Simd::addi(idx, oneI), zeroI, last);
+                    if constexpr (LINEAR)
+                    {
+                        I stride = Simd::seti(s.stride[a]);
+                        lo[a]    = Simd::muli(idxLo, stride);
+                        hi[a]    = Simd::muli(idxHi, stride);
+                    }
+                    else
+                    {
+                        lo[a] = Simd::gatheri(s.offsets[a], idxLo);
+                        hi[a] = Simd::gatheri(s.offsets[a], idxHi);
+                    }
+                }
+                I lo12 = Simd::addi(lo[1], lo[2]);
+                I hi1  = Simd::addi(hi[1], lo[2]);
+                I hi2  = Simd::addi(lo[1], hi[2]);
+                I hi12 = Simd::addi(hi[1], hi[2]);
+
+                F c00 = Simd::lerp(voxel(Simd::addi(lo[0], lo12), active), voxel(Simd::addi(hi[0], lo12), active),
+                                   frac[0]);
+                F c10 = Simd::lerp(voxel(Simd::addi(lo[0], hi1), active), voxel(Simd::addi(hi[0], hi1), active),
+                                   frac[0]);
+                F c01 = Simd::lerp(voxel(Simd::addi(lo[0], hi2), active), voxel(Simd::addi(hi[0], hi2), active),
+                                   frac[0]);
+                F c11 = Simd::lerp(voxel(Simd::addi(lo[0], hi12), active), voxel(Simd::addi(hi[0], hi12), active),
+                                   frac[0]);
+                F c0  = Simd::lerp(c00, c10, frac[1]);
+                F c1  = Simd::lerp(c01, c11, frac[1]);
+                sum   = Simd::add(sum, Simd::lerp(c0, c1, frac[2]));
+            }
+
+            if constexpr (FORMAT == SampleFormat::UInt16)
+            {
+                sum = Simd::fmadd(Simd::set(s.scale), sum, Simd::mul(Simd::set(s.bias), numSteps));
+            }
+            F stepLength = Simd::div(length, Simd::max(numSteps, one));
+            F result     = Simd::mul(Simd::mul(sum, stepLength), Simd::set(s.worldScale));
+
+            alignas(64) float resultLanes[W];
+            alignas(64) float stepLanes[W];
+            Simd::store(resultLanes, result);
+            Simd::store(stepLanes, numSteps);
+            int count = tile.x1 - x0 < W ? tile.x1 - x0 : W;
+            for (int l = 0; l < count; ++l)
+            {
+                row[x0 + l] = resultLanes[l];
+                samples += static_cast< int64_t >(stepLanes[l]);
+            }
+        }
+    }
+    return samples;
+}
+
+// `projectPacketTile` for the layout and sample format of `s`
+template< typename Simd >
+auto projectPacketTileFor(const PacketSetup& s, const DetectorTile& tile) -> int64_t
+{
+    switch (s.format)
+    {
+    case SampleFormat::UInt16:
+        return s.offsets[0] ? projectPacketTile< Simd, false, SampleFormat::UInt16 >(s, tile)
+                            : projectPacketTile< Simd, true, SampleFormat::UInt16 >(s, tile);
+    case SampleFormat::Float16:
+        return s.offsets[0] ? projectPacketTile< Simd, false, SampleFormat::Float16 >(s, tile)
+                            : projectPacketTile< Simd, true, SampleFormat::Float16 >(s, tile);
+    case SampleFormat::Float32:
+        break;
+    }
+    return s.offsets[0] ? projectPacketTile< Simd, false, SampleFormat::Float32 >(s, tile)
+                        : projectPacketTile< Simd, true, SampleFormat::Float32 >(s, tile);
+}
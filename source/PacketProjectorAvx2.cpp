@@ -0,0 +1,87 @@
+/*
+ * PacketProjectorAvx2.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+// Compiled with AVX2/FMA enabled (see CMakeLists.txt), only called after a runtime CPU check
+
+#include "PacketProjector.hpp"
+
+#if defined(__AVX2__)
+#    include <immintrin.h>
+
+namespace
+{
+struct Avx2Lanes
+{
+    static constexpr int WIDTH = 8;
+    using Float                = __m256;
+    using Int                  = __m256i;
+    using Mask                 = __m256;
+
+    static inline auto set(float v) -> Float { return _mm256_set1_ps(v); }
+    static inline auto seti(int32_t v) -> Int { return _mm256_set1_epi32(v); }
+    static inline auto iota() -> Float { return _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f); }
+    static inline auto add(Float a, Float b) -> Float { return _mm256_add_ps(a, b); }
+    static inline auto sub(Float a, Float b) -> Float { return _mm256_sub_ps(a, b); }
+    static inline auto mul(Float a, Float b) -> Float { return _mm256_mul_ps(a, b); }
+    static inline auto div(Float a, Float b) -> Float { return _mm256_div_ps(a, b); }
+    static inline auto fmadd(Float a, Float b, Float c) -> Float { return _mm256_fmadd_ps(a, b, c); }
+    static inline auto min(Float a, Float b) -> Float { return _mm256_min_ps(a, b); }
+    static inline auto max(Float a, Float b) -> Float { return _mm256_max_ps(a, b); }
+    static inline auto sqrt(Float a) -> Float { return _mm256_sqrt_ps(a); }
+    static inline auto ceil(Float a) -> Float { return _mm256_ceil_ps(a); }
+    static inline auto floor(Float a) -> Float { return _mm256_floor_ps(a); }
+    static inline auto lerp(Float a, Float b, Float t) -> Float { return _mm256_fmadd_ps(t, _mm256_sub_ps(b, a), a); }
+    static inline auto toInt(Float a) -> Int { return _mm256_cvttps_epi32(a); }
+    static inline auto addi(Int a, Int b) -> Int { return _mm256_add_epi32(a, b); }
+    static inline auto muli(Int a, Int b) -> Int { return _mm256_mullo_epi32(a, b); }
+    static inline auto clampi(Int a, Int lower, Int upper) -> Int
+    {
+        return _mm256_min_epi32(_mm256_max_epi32(a, lower), upper);
+    }
+    static inline auto less(Float a, Float b) -> Mask { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static inline auto land(Mask a, Mask b) -> Mask { return _mm256_and_ps(a, b); }
+    static inline auto any(Mask m) -> bool { return _mm256_movemask_ps(m) != 0; }
+    static inline auto select(Mask m, Float a, Float b) -> Float { return _mm256_blendv_ps(b, a, m); }
+    static inline auto gather(const float* base, Int offsets, Mask m) -> Float
+    {
+        return _mm256_mask_i32gather_ps(_mm256_setzero_ps(), base, offsets, m, 4);
+    }
+    static inline auto gatheri(const int32_t* base, Int indices) -> Int
+    {
+        return _mm256_i32gather_epi32(reinterpret_cast< const int* >(base), indices, 4);
+    }
+    // 32 bit gather at 2 byte scale, the upper half belongs to the next sample
+    static inline auto gatheru16(const uint16_t* base, Int offsets, Mask m) -> Int
+    {
+        auto words = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast< const int* >(base),
+                                                 offsets, _mm256_castps_si256(m), 2);
+        return _mm256_and_si256(words, _mm256_set1_epi32(0xffff));
+    }
+    static inline auto toFloat(Int a) -> Float { return _mm256_cvtepi32_ps(a); }
+    // Like `::halfToFloat` (without F16C): shift exponent and mantissa into place, rebias by multiplying with 2^112
+    static inline auto halfToFloat(Int half) -> Float
+    {
+        auto magnitude = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(half, _mm256_set1_epi32(0x7fff)), 13));
+        auto sign      = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(half, _mm256_set1_epi32(0x8000)), 16));
+        return _mm256_or_ps(_mm256_mul_ps(magnitude, _mm256_set1_ps(0x1.0p112f)), sign);
+    }
+    static inline auto load(const float* p) -> Float { return _mm256_loadu_ps(p); }
+    static inline void store(float* p, Float a) { _mm256_store_ps(p, a); }
+};
+} // namespace
+
+auto projectPacketsAvx2(const PacketSetup& setup, const DetectorTile& tile, int64_t& samples) -> bool
+{
+    samples = projectPacketTileFor< Avx2Lanes >(setup, tile);
+    return true;
+}
+#else
+auto projectPacketsAvx2(const PacketSetup& /*setup*/, const DetectorTile& /*tile*/, int64_t& /*samples*/) -> bool
+{
+    return false;
+}
+#endif
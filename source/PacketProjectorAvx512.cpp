@@ -0,0 +1,96 @@
+/*
+ * PacketProjectorAvx512.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+// Compiled with AVX-512F enabled (see CMakeLists.txt), only called after a runtime CPU check
+
+#include "PacketProjector.hpp"
+
+#if defined(__AVX512F__)
+#    include <immintrin.h>
+
+namespace
+{
+struct Avx512Lanes
+{
+    static constexpr int WIDTH = 16;
+    using Float                = __m512;
+    using Int                  = __m512i;
+    using Mask                 = __mmask16;
+
+    static inline auto set(float v) -> Float { return _mm512_set1_ps(v); }
+    static inline auto seti(int32_t v) -> Int { return _mm512_set1_epi32(v); }
+    static inline auto iota() -> Float
+    {
+        return _mm512_set_ps(15.f, 14.f, 13.f, 12.f, 11.f, 10.f, 9.f, 8.f, 7.f, 6.f, 5.f, 4.f, 3.f, 2.f, 1.f, 0.f);
+    }
+    static inline auto add(Float a, Float b) -> Float { return _mm512_add_ps(a, b); }
+    static inline auto sub(Float a, Float b) -> Float { return _mm512_sub_ps(a, b); }
+    static inline auto mul(Float a, Float b) -> Float { return _mm512_mul_ps(a, b); }
+    static inline auto div(Float a, Float b) -> Float { return _mm512_div_ps(a, b); }
+    static inline auto fmadd(Float a, Float b, Float c) -> Float { return _mm512_fmadd_ps(a, b, c); }
+    static inline auto min(Float a, Float b) -> Float { return _mm512_min_ps(a, b); }
+    static inline auto max(Float a, Float b) -> Float { return _mm512_max_ps(a, b); }
+    static inline auto sqrt(Float a) -> Float { return _mm512_sqrt_ps(a); }
+    static inline auto ceil(Float a) -> Float
+    {
+        return _mm512_roundscale_ps(a, _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC);
+    }
+    static inline auto floor(Float a) -> Float
+    {
+        return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    }
+    static inline auto lerp(Float a, Float b, Float t) -> Float { return _mm512_fmadd_ps(t, _mm512_sub_ps(b, a), a); }
+    static inline auto toInt(Float a) -> Int { return _mm512_cvttps_epi32(a); }
+    static inline auto addi(Int a, Int b) -> Int { return _mm512_add_epi32(a, b); }
+    static inline auto muli(Int a, Int b) -> Int { return _mm512_mullo_epi32(a, b); }
+    static inline auto clampi(Int a, Int lower, Int upper) -> Int
+    {
+        return _mm512_min_epi32(_mm512_max_epi32(a, lower), upper);
+    }
+    static inline auto less(Float a, Float b) -> Mask { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static inline auto land(Mask a, Mask b) -> Mask { return static_cast< Mask >(a & b); }
+    static inline auto any(Mask m) -> bool { return m != 0; }
+    static inline auto select(Mask m, Float a, Float b) -> Float { return _mm512_mask_blend_ps(m, b, a); }
+    static inline auto gather(const float* base, Int offsets, Mask m) -> Float
+    {
+        return _mm512_mask_i32gather_ps(_mm512_setzero_ps(), m, offsets, base, 4);
+    }
+    static inline auto gatheri(const int32_t* base, Int indices) -> Int
+    {
+        return _mm512_i32gather_epi32(indices, base, 4);
+    }
+    // 32 bit gather at 2 byte scale, the upper half belongs to the next sample
+    static inline auto gatheru16(const uint16_t* base, Int offsets, Mask m) -> Int
+    {
+        auto words = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), m, offsets, base, 2);
+        return _mm512_and_si512(words, _mm512_set1_epi32(0xffff));
+    }
+    static inline auto toFloat(Int a) -> Float { return _mm512_cvtepi32_ps(a); }
+    // Like `::halfToFloat` (without F16C): shift exponent and mantissa into place, rebias by multiplying with 2^112
+    static inline auto halfToFloat(Int half) -> Float
+    {
+        auto magnitude = _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_and_si512(half, _mm512_set1_epi32(0x7fff)), 13));
+        auto sign      = _mm512_slli_epi32(_mm512_and_si512(half, _mm512_set1_epi32(0x8000)), 16);
+        return _mm512_castsi512_ps(
+            _mm512_or_si512(_mm512_castps_si512(_mm512_mul_ps(magnitude, _mm512_set1_ps(0x1.0p112f))), sign));
+    }
+    static inline auto load(const float* p) -> Float { return _mm512_loadu_ps(p); }
+    static inline void store(float* p, Float a) { _mm512_store_ps(p, a); }
+};
+} // namespace
+
+auto projectPacketsAvx512(const PacketSetup& setup, const DetectorTile& tile, int64_t& samples) -> bool
+{
+    samples = projectPacketTileFor< Avx512Lanes >(setup, tile);
+    return true;
+}
+#else
+auto projectPacketsAvx512(const PacketSetup& /*setup*/, const DetectorTile& /*tile*/, int64_t& /*samples*/) -> bool
+{
+    return false;
+}
+#endif
@@ -0,0 +1,246 @@
+/*
+ * ParallelImport.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "ParallelImport.hpp"
+
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <locale>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+// Python's `os.walk` order: the directory itself, then the subtrees of its subdirectories
+void appendPreorder(const std::vector< DirectoryNode >& nodes, size_t index, std::vector< DirectoryNode >& tree)
+{
+    auto node = nodes[index];
+    node.children.clear();
+    auto position = tree.size();
+    tree.push_back(node);
+    for (auto child : nodes[index].children)
+    {
+        tree[position].children.push_back(tree.size());
+        appendPreorder(nodes, child, tree);
+    }
+}
+
+auto endsWith(const std::string& string, const std::string& suffix) -> bool
+{
+    return string.size() >= suffix.size() && string.compare(string.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+} // namespace
+
+void parallelFor(size_t count, int concurrency, const std::function< void(size_t) >& work)
+{
+    auto threadCount = std::min(count, static_cast< size_t >(std::max(concurrency, 1)));
+    std::atomic< size_t > next{ 0 };
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++)
+        {
+            try
+            {
+                work(i);
+            } catch (...)
+            {
+                std::lock_guard< std::mutex > lock(errorMutex);
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+            }
+        }
+    };
+
+    // The calling thread works as well, so that a concurrency of 1 does not start any thread
+    std::vector< std::thread > threads;
+    for (size_t t = 1; t < threadCount; ++t)
+    {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+auto scanDirectoryTree(const std::string& dirname, int concurrency) -> std::vector< DirectoryNode >
+{
+    std::vector< DirectoryNode > nodes(1);
+    nodes[0].path = dirname;
+    std::vector< size_t > level{ 0 };
+    while (!level.empty())
+    {
+        // Listing is latency bound on network file systems, all directories of one level are listed concurrently
+        std::vector< std::vector< std::string > > subdirectories(level.size());
+        parallelFor(level.size(), concurrency, [&](size_t i) {
+            auto& node = nodes[level[i]];
+            QDirIterator it(QString::fromStdString(node.path), QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+            while (it.hasNext())
+            {
+                it.next();
+                auto info = it.fileInfo();
+                if (info.isDir())
+                {
+                    subdirectories[i].push_back(info.filePath().toStdString());
+                }
+                else
+                {
+                    node.files.push_back(info.fileName().toStdString());
+                }
+            }
+            std::sort(node.files.begin(), node.files.end());
+            std::sort(subdirectories[i].begin(), subdirectories[i].end());
+        });
+
+        std::vector< size_t > nextLevel;
+        for (size_t i = 0; i < level.size(); ++i)
+        {
+            for (auto& path : subdirectories[i])
+            {
+                nodes[level[i]].children.push_back(nodes.size());
+                nextLevel.push_back(nodes.size());
+                DirectoryNode child;
+                child.path = path;
+                nodes.push_back(child);
+            }
+        }
+        level.swap(nextLevel);
+    }
+
+    std::vector< DirectoryNode > tree;
+    tree.reserve(nodes.size());
+    appendPreorder(nodes, 0, tree);
+    return tree;
+}
+
+auto groupProjectionSources(const std::vector< DirectoryNode >& tree) -> std::vector< std::vector< ProjectionSource > >
+{
+    std::vector< std::vector< ProjectionSource > > pumpkins(1);
+    for (auto& node : tree)
+    {
+        if (!node.children.empty())
+        {
+            if (!pumpkins.back().empty())
+            {
+                pumpkins.emplace_back();
+            }
+            continue;
+        }
+
+        auto matrix = std::find(node.files.begin(), node.files.end(), "pmat_3x4.txt");
+        auto image  = std::find_if(node.files.begin(), node.files.end(),
+                                  [](const std::string& name) { return endsWith(name, ".IMA"); });
+        if (matrix == node.files.end() || image == node.files.end())
+        {
+            qDebug() << "Skipping" << QString::fromStdString(node.path) << ": no projection matrix or DICOM file";
+            continue;
+        }
+        ProjectionSource source;
+        source.image      = node.path + "/" + *image;
+        source.matrixFile = node.path + "/" + *matrix;
+        pumpkins.back().push_back(source);
+    }
+    if (pumpkins.back().empty())
+    {
+        pumpkins.pop_back();
+    }
+    return pumpkins;
+}
+
+auto indexProjections(const std::string& dirname, int concurrency) -> std::vector< ProjectionIndex >
+{
+    std::vector< ProjectionSource > sources;
+    std::vector< size_t > pumpkinOf;
+    auto pumpkins = groupProjectionSources(scanDirectoryTree(dirname, concurrency));
+    for (size_t p = 0; p < pumpkins.size(); ++p)
+    {
+        sources.insert(sources.end(), pumpkins[p].begin(), pumpkins[p].end());
+        pumpkinOf.insert(pumpkinOf.end(), pumpkins[p].size(), p);
+    }
+
+    std::vector< Geometry::ProjectionMatrix > matrices(sources.size());
+    std::vector< char > valid(sources.size(), 0);
+    parallelFor(sources.size(), concurrency, [&](size_t i) {
+        try
+        {
+            matrices[i] = readProjectionMatrix(sources[i].matrixFile);
+            valid[i]    = 1;
+        } catch (std::exception& exp)
+        {
+            qDebug() << "Skipping" << QString::fromStdString(sources[i].image) << ":" << exp.what();
+        }
+    });
+
+    std::vector< ProjectionIndex > index(pumpkins.size());
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        if (valid[i])
+        {
+            index[pumpkinOf[i]].files.push_back(sources[i].image);
+            index[pumpkinOf[i]].matrices.push_back(matrices[i]);
+        }
+    }
+    index.erase(std::remove_if(index.begin(), index.end(),
+                               [](const ProjectionIndex& pumpkin) { return pumpkin.files.empty(); }),
+                index.end());
+    return index;
+}
+
+auto readProjectionMatrix(const std::string& path) -> Geometry::ProjectionMatrix
+{
+    auto bytes = readFileBytes(path);
+    std::istringstream stream(std::string(bytes.begin(), bytes.end()));
+    stream.imbue(std::locale::classic());
+    Geometry::ProjectionMatrix matrix;
+    for (int row = 0; row < 3; ++row)
+    {
+        for (int col = 0; col < 4; ++col)
+        {
+            double value = 0.;
+            if (!(stream >> value))
+            {
+                throw std::runtime_error("Expected 3x4 values in " + path);
+            }
+            // Rounded like the float32 matrices of `epipolar.index_projections`
+            matrix(row, col) = static_cast< double >(static_cast< float >(value));
+        }
+    }
+    return matrix;
+}
+
+auto readFileBytes(const std::string& path) -> std::vector< char >
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Could not open " + path);
+    }
+    std::vector< char > bytes(static_cast< size_t >(file.tellg()));
+    file.seekg(0);
+    file.read(bytes.data(), static_cast< std::streamsize >(bytes.size()));
+    if (!file || static_cast< size_t >(file.gcount()) != bytes.size())
+    {
+        throw std::runtime_error("Could not read " + path);
+    }
+    return bytes;
+}
@@ -0,0 +1,63 @@
+/*
+ * ParallelImport.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "ProjectiveGeometry.hxx"
+
+// Default number of concurrent reads. Network file systems need many outstanding requests to reach their bandwidth.
+constexpr int DEFAULT_IO_CONCURRENCY = 8;
+
+// Runs `work(i)` for all i < `count` on up to `concurrency` threads. The first exception is rethrown after all items
+// have been processed.
+void parallelFor(size_t count, int concurrency, const std::function< void(size_t) >& work);
+
+// Directory with its files and subdirectories, sorted by name
+struct DirectoryNode
+{
+    std::string path;
+    std::vector< std::string > files; // names
+    std::vector< size_t > children;   // indices of the subdirectories
+};
+
+// All directories below `dirname` in the order of a top-down `os.walk`. Each level of the tree is listed in parallel.
+auto scanDirectoryTree(const std::string& dirname, int concurrency = DEFAULT_IO_CONCURRENCY)
+    -> std::vector< DirectoryNode >;
+
+// Files of one real projection: a leaf directory with a projection matrix and a DICOM file
+struct ProjectionSource
+{
+    std::string image;
+    std::string matrixFile;
+};
+
+// Leaf directories grouped into pumpkins like `epipolar.read_projections`: a directory with subdirectories starts a new
+// pumpkin once the current one has projections. Leaves without "pmat_3x4.txt" or .IMA file are skipped.
+auto groupProjectionSources(const std::vector< DirectoryNode >& tree) -> std::vector< std::vector< ProjectionSource > >;
+
+// DICOM files and matrices of one pumpkin
+struct ProjectionIndex
+{
+    std::vector< std::string > files;
+    std::vector< Geometry::ProjectionMatrix > matrices;
+};
+
+// Native `epipolar.index_projections`: the tree is scanned and the matrices are read with up to `concurrency` reads in
+// flight. Projections with a broken matrix are skipped, pumpkins without projections are dropped.
+auto indexProjections(const std::string& dirname, int concurrency = DEFAULT_IO_CONCURRENCY)
+    -> std::vector< ProjectionIndex >;
+
+// Space separated 3x4 matrix (pmat_3x4.txt), rounded to float precision. Throws std::runtime_error for broken files.
+auto readProjectionMatrix(const std::string& path) -> Geometry::ProjectionMatrix;
+
+// Whole file. Throws std::runtime_error if it cannot be read.
+auto readFileBytes(const std::string& path) -> std::vector< char >;
@@ -0,0 +1,53 @@
+/*
+ * PointProjectionKernel.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+// Single precision projection of points (structure of arrays, see `PointSet`) to the pixels of one view
+struct PointProjectionSetup
+{
+    const float* x;
+    const float* y;
+    const float* z;
+    size_t count;     // multiple of PITCH_ALIGNMENT, the arrays are padded
+    float matrix[12]; // row major, for points relative to the origin of the point set
+    float* u;
+    float* v;
+
+    static constexpr size_t PITCH_ALIGNMENT = 16; // widest vector
+};
+
+// Projects `Simd::WIDTH` points at once: three fused dot products and two divisions per point. Only uses operations of
+// `Simd` so that this can be instantiated in translation units with different target flags.
+template< typename Simd >
+void projectPointsFor(const PointProjectionSetup& s)
+{
+    using F = typename Simd::Float;
+    F m[12];
+    for (int i = 0; i < 12; ++i)
+    {
+        m[i] = Simd::set(s.matrix[i]);
+    }
+    for (size_t i = 0; i < s.count; i += Simd::WIDTH)
+    {
+        F x = Simd::load(s.x + i);
+        F y = Simd::load(s.y + i);
+        F z = Simd::load(s.z + i);
+        F u = Simd::fmadd(x, m[0], Simd::fmadd(y, m[1], Simd::fmadd(z, m[2], m[3])));
+        F v = Simd::fmadd(x, m[4], Simd::fmadd(y, m[5], Simd::fmadd(z, m[6], m[7])));
+        F w = Simd::fmadd(x, m[8], Simd::fmadd(y, m[9], Simd::fmadd(z, m[10], m[11])));
+        Simd::store(s.u + i, Simd::div(u, w));
+        Simd::store(s.v + i, Simd::div(v, w));
+    }
+}
+
+// Implemented in translation units compiled for the respective instruction set.
+// Return false if the compiler could not generate code for it.
+auto projectPointsAvx2(const PointProjectionSetup& setup) -> bool;
+auto projectPointsAvx512(const PointProjectionSetup& setup) -> bool;
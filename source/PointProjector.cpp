@@ -0,0 +1,128 @@
+/*
+ * PointProjector.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "PointProjector.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "PointProjectionKernel.hpp"
+
+namespace
+{
+struct ScalarLanes
+{
+    static constexpr int WIDTH = 1;
+    using Float                = float;
+
+    static inline auto set(float v) -> Float { return v; }
+    static inline auto div(Float a, Float b) -> Float { return a / b; }
+    static inline auto fmadd(Float a, Float b, Float c) -> Float { return a * b + c; }
+    static inline auto load(const float* p) -> Float { return *p; }
+    static inline void store(float* p, Float a) { *p = a; }
+};
+
+// `matrix` for points relative to `origin`, scaled so that w is the depth in the units of the points
+auto relativeMatrix(const Geometry::ProjectionMatrix& matrix, const Eigen::Vector3d& origin)
+    -> Geometry::ProjectionMatrix
+{
+    Geometry::ProjectionMatrix relative = matrix;
+    relative.col(3) += matrix.leftCols< 3 >() * origin;
+    auto norm = relative.block< 1, 3 >(2, 0).norm();
+    return norm > 0. ? Geometry::ProjectionMatrix(relative / norm) : relative;
+}
+
+void projectView(const PointProjectionSetup& setup, SimdLevel simd)
+{
+    if (simd == SimdLevel::Avx512 && projectPointsAvx512(setup))
+    {
+        return;
+    }
+    if ((simd == SimdLevel::Avx512 || simd == SimdLevel::Avx2) && projectPointsAvx2(setup))
+    {
+        return;
+    }
+    projectPointsFor< ScalarLanes >(setup);
+}
+} // namespace
+
+PointSet::PointSet(const std::vector< Geometry::RP3Point >& points) : m_size(points.size())
+{
+    std::vector< Eigen::Vector3d > positions(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        positions[i] = points[i].head< 3 >() / points[i](3);
+        m_origin += positions[i];
+    }
+    m_origin /= static_cast< double >(std::max< size_t >(points.size(), 1));
+
+    auto alignment = PointProjectionSetup::PITCH_ALIGNMENT;
+    auto pitch     = (points.size() + alignment - 1) / alignment * alignment;
+    m_x.assign(pitch, 0.f);
+    m_y.assign(pitch, 0.f);
+    m_z.assign(pitch, 0.f);
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        Eigen::Vector3f relative = (positions[i] - m_origin).cast< float >();
+        m_x[i]                   = relative[0];
+        m_y[i]                   = relative[1];
+        m_z[i]                   = relative[2];
+    }
+}
+
+void projectPoints(const PointSet& points, const std::vector< Geometry::ProjectionMatrix >& matrices,
+                   ProjectedPoints& projected, SimdLevel simd)
+{
+    simd            = supportedSimdLevel(simd);
+    projected.pitch = points.pitch();
+    projected.u.resize(matrices.size() * points.pitch());
+    projected.v.resize(matrices.size() * points.pitch());
+    for (size_t view = 0; view < matrices.size(); ++view)
+    {
+        PointProjectionSetup setup{};
+        setup.x     = points.x();
+        setup.y     = points.y();
+        setup.z     = points.z();
+        setup.count = points.pitch();
+        setup.u     = projected.u.data() + projected.index(view, 0);
+        setup.v     = projected.v.data() + projected.index(view, 0);
+        auto matrix = relativeMatrix(matrices[view], points.origin());
+        for (int i = 0; i < 12; ++i)
+        {
+            setup.matrix[i] = static_cast< float >(matrix(i / 4, i % 4));
+        }
+        projectView(setup, simd);
+    }
+}
+
+void projectPoints(const PointSet& points, const GeometryTable& geometries, const std::vector< size_t >& views,
+                   ProjectedPoints& projected, SimdLevel simd)
+{
+    std::vector< Geometry::ProjectionMatrix > matrices;
+    matrices.reserve(views.size());
+    for (auto view : views)
+    {
+        matrices.push_back(geometries.pixelProjection(view));
+    }
+    projectPoints(points, matrices, projected, simd);
+}
+
+auto projectionErrorBound(const Geometry::ProjectionMatrix& matrix, const Geometry::RP3Point& point,
+                          const Eigen::Vector3d& origin) -> double
+{
+    constexpr double UNIT_ROUNDOFF = 0x1.0p-24;
+    auto relative                  = relativeMatrix(matrix, origin);
+    Eigen::Vector4d position;
+    position << point.head< 3 >() / point(3) - origin, 1.;
+
+    Eigen::Vector3d sums  = relative.cwiseAbs() * position.cwiseAbs();
+    Eigen::Vector3d pixel = relative * position;
+    auto w                = std::abs(pixel[2]);
+    auto x                = std::abs(pixel[0] / pixel[2]);
+    auto y                = std::abs(pixel[1] / pixel[2]);
+    return 8. * UNIT_ROUNDOFF * std::max(sums[0] + x * sums[2], sums[1] + y * sums[2]) / w;
+}
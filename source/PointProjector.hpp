@@ -0,0 +1,69 @@
+/*
+ * PointProjector.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <Eigen/Core>
+#include <vector>
+
+#include "ForwardProjector.hpp"
+#include "GeometryTable.hpp"
+#include "ProjectiveGeometry.hxx"
+
+// Finite 3D points as structure of arrays in single precision. They are stored relative to their centroid, which keeps
+// the float coordinates small; the offset is applied to the matrices in double precision.
+class PointSet
+{
+  public:
+    PointSet() = default;
+    explicit PointSet(const std::vector< Geometry::RP3Point >& points);
+
+    [[nodiscard]] auto size() const -> size_t { return m_size; }
+    // Length of the arrays, padded to a multiple of `PointProjectionSetup::PITCH_ALIGNMENT`
+    [[nodiscard]] auto pitch() const -> size_t { return m_x.size(); }
+    [[nodiscard]] auto origin() const -> const Eigen::Vector3d& { return m_origin; }
+    [[nodiscard]] auto x() const -> const float* { return m_x.data(); }
+    [[nodiscard]] auto y() const -> const float* { return m_y.data(); }
+    [[nodiscard]] auto z() const -> const float* { return m_z.data(); }
+
+  private:
+    std::vector< float > m_x;
+    std::vector< float > m_y;
+    std::vector< float > m_z;
+    size_t m_size = 0;
+    Eigen::Vector3d m_origin = Eigen::Vector3d::Zero();
+};
+
+// Pixels of all points in all views, view major with rows of `pitch` values (the padding is undefined)
+struct ProjectedPoints
+{
+    std::vector< float > u;
+    std::vector< float > v;
+    size_t pitch = 0;
+
+    [[nodiscard]] auto index(size_t view, size_t point) const -> size_t { return view * pitch + point; }
+};
+
+// Projects all points with each matrix, `projected` is only reallocated if it is too small. Points on the principal
+// plane of a view give infinite or NaN pixels.
+//
+// Accuracy: with u = 2^-24 (float rounding) the pixel coordinate x of point X differs from the double precision
+// result (`Geometry::SourceDetectorGeometry::project` or P * X) by at most
+//     8u * (S_x + |x| * S_w) / |w|,   S_r = sum_j |M_rj * X_j|,
+// where M is the matrix relative to the origin of the points, X = (point - origin, 1) and w = M_3 * X is the depth.
+// That is 4u for the dot products, u for each of M and X rounded to float and u for the division, with some margin.
+// `projectionErrorBound` evaluates it. For a C-arm (750 mm to the isocenter, 0.308 mm pixels) and points in a 100 mm
+// cube it is about 1e-3 pixels, the measured errors stay below a third of it.
+void projectPoints(const PointSet& points, const std::vector< Geometry::ProjectionMatrix >& matrices,
+                   ProjectedPoints& projected, SimdLevel simd = SimdLevel::Best);
+// The `GeometryTable::pixelProjection` of each of `views`, same pixels as `Geometry::SourceDetectorGeometry::project`
+void projectPoints(const PointSet& points, const GeometryTable& geometries, const std::vector< size_t >& views,
+                   ProjectedPoints& projected, SimdLevel simd = SimdLevel::Best);
+
+// Bound on the error of `projectPoints` in pixels (both coordinates) for `point` of a set with `origin`
+auto projectionErrorBound(const Geometry::ProjectionMatrix& matrix, const Geometry::RP3Point& point,
+                          const Eigen::Vector3d& origin) -> double;
@@ -0,0 +1,40 @@
+/*
+ * PointProjectorAvx2.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+// Compiled with AVX2/FMA enabled (see CMakeLists.txt), only called after a runtime CPU check
+
+#include "PointProjectionKernel.hpp"
+
+#if defined(__AVX2__)
+#    include <immintrin.h>
+
+namespace
+{
+struct Avx2Lanes
+{
+    static constexpr int WIDTH = 8;
+    using Float                = __m256;
+
+    static inline auto set(float v) -> Float { return _mm256_set1_ps(v); }
+    static inline auto div(Float a, Float b) -> Float { return _mm256_div_ps(a, b); }
+    static inline auto fmadd(Float a, Float b, Float c) -> Float { return _mm256_fmadd_ps(a, b, c); }
+    static inline auto load(const float* p) -> Float { return _mm256_loadu_ps(p); }
+    static inline void store(float* p, Float a) { _mm256_storeu_ps(p, a); }
+};
+} // namespace
+
+auto projectPointsAvx2(const PointProjectionSetup& setup) -> bool
+{
+    projectPointsFor< Avx2Lanes >(setup);
+    return true;
+}
+#else
+auto projectPointsAvx2(const PointProjectionSetup& /*setup*/) -> bool
+{
+    return false;
+}
+#endif
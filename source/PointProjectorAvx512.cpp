@@ -0,0 +1,40 @@
+/*
+ * PointProjectorAvx512.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+// Compiled with AVX-512F enabled (see CMakeLists.txt), only called after a runtime CPU check
+
+#include "PointProjectionKernel.hpp"
+
+#if defined(__AVX512F__)
+#    include <immintrin.h>
+
+namespace
+{
+struct Avx512Lanes
+{
+    static constexpr int WIDTH = 16;
+    using Float                = __m512;
+
+    static inline auto set(float v) -> Float { return _mm512_set1_ps(v); }
+    static inline auto div(Float a, Float b) -> Float { return _mm512_div_ps(a, b); }
+    static inline auto fmadd(Float a, Float b, Float c) -> Float { return _mm512_fmadd_ps(a, b, c); }
+    static inline auto load(const float* p) -> Float { return _mm512_loadu_ps(p); }
+    static inline void store(float* p, Float a) { _mm512_storeu_ps(p, a); }
+};
+} // namespace
+
+auto projectPointsAvx512(const PointProjectionSetup& setup) -> bool
+{
+    projectPointsFor< Avx512Lanes >(setup);
+    return true;
+}
+#else
+auto projectPointsAvx512(const PointProjectionSetup& /*setup*/) -> bool
+{
+    return false;
+}
+#endif
@@ -0,0 +1,265 @@
+/*
+ * ProjectionCache.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "ProjectionCache.hpp"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME  = 1099511628211ull;
+constexpr char MAGIC[8]       = { 'E', 'P', 'I', 'P', 'R', 'O', 'J', '1' };
+
+// FNV-1a
+inline auto hashBytes(uint64_t hash, const void* data, size_t bytes) -> uint64_t
+{
+    auto* p = static_cast< const unsigned char* >(data);
+    for (size_t i = 0; i < bytes; ++i)
+    {
+        hash = (hash ^ p[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+template< typename T >
+inline auto hashValue(uint64_t hash, const T& value) -> uint64_t
+{
+    return hashBytes(hash, &value, sizeof(T));
+}
+
+// Fixed size file header, followed by width * height floats
+struct FileHeader
+{
+    char magic[8];
+    uint64_t volume;
+    double matrix[12];
+    int32_t width;
+    int32_t height;
+    double detectorSpacing;
+    double volumeSpacing;
+    int32_t engine;
+    int32_t emptySpaceSkipping;
+};
+
+auto toHeader(const ProjectionKey& key) -> FileHeader
+{
+    FileHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.volume = key.volume;
+    std::copy(key.matrix.begin(), key.matrix.end(), header.matrix);
+    header.width              = key.width;
+    header.height             = key.height;
+    header.detectorSpacing    = key.detectorSpacing;
+    header.volumeSpacing      = key.volumeSpacing;
+    header.engine             = key.engine;
+    header.emptySpaceSkipping = key.emptySpaceSkipping;
+    return header;
+}
+} // namespace
+
+auto ProjectionKey::hash() const -> uint64_t
+{
+    uint64_t h = hashValue(FNV_OFFSET, volume);
+    h          = hashBytes(h, matrix.data(), matrix.size() * sizeof(double));
+    h          = hashValue(h, width);
+    h          = hashValue(h, height);
+    h          = hashValue(h, detectorSpacing);
+    h          = hashValue(h, volumeSpacing);
+    h          = hashValue(h, engine);
+    return hashValue(h, emptySpaceSkipping);
+}
+
+auto ProjectionKey::operator==(const ProjectionKey& other) const -> bool
+{
+    return volume == other.volume && matrix == other.matrix && width == other.width && height == other.height &&
+           detectorSpacing == other.detectorSpacing && volumeSpacing == other.volumeSpacing && engine == other.engine &&
+           emptySpaceSkipping == other.emptySpaceSkipping;
+}
+
+auto contentHash(const VolumeView& volume) -> uint64_t
+{
+    // Rows are hashed in parallel and combined in order
+    std::vector< uint64_t > rowHashes(static_cast< size_t >(volume.size[0] * volume.size[1]));
+#pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < volume.size[0]; ++i)
+    {
+        for (int64_t j = 0; j < volume.size[1]; ++j)
+        {
+            uint64_t h = FNV_OFFSET;
+            for (int64_t k = 0; k < volume.size[2]; ++k)
+            {
+                uint32_t bits = 0;
+                float value   = volume.at(i, j, k);
+                std::memcpy(&bits, &value, sizeof(bits));
+                h = (h ^ bits) * FNV_PRIME;
+            }
+            rowHashes[static_cast< size_t >(i * volume.size[1] + j)] = h;
+        }
+    }
+
+    uint64_t h = hashBytes(FNV_OFFSET, volume.size.data(), volume.size.size() * sizeof(int64_t));
+    return hashBytes(h, rowHashes.data(), rowHashes.size() * sizeof(uint64_t));
+}
+
+ProjectionCache::ProjectionCache(size_t byteBudget, std::string directory)
+    : m_byteBudget(byteBudget), m_directory(std::move(directory))
+{
+}
+
+auto ProjectionCache::find(const ProjectionKey& key) -> Projection
+{
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        auto it = m_index.find(key.hash());
+        if (it != m_index.end() && it->second->key == key)
+        {
+            m_entries.splice(m_entries.begin(), m_entries, it->second);
+            return it->second->projection;
+        }
+    }
+
+    auto projection = load(key);
+    if (projection)
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        insertLocked(key, projection);
+    }
+    return projection;
+}
+
+void ProjectionCache::insert(const ProjectionKey& key, std::vector< float > projection)
+{
+    store(key, projection);
+    std::lock_guard< std::mutex > lock(m_mutex);
+    insertLocked(key, std::make_shared< const std::vector< float > >(std::move(projection)));
+}
+
+void ProjectionCache::setByteBudget(size_t byteBudget)
+{
+    std::lock_guard< std::mutex > lock(m_mutex);
+    m_byteBudget = byteBudget;
+    evictLocked();
+}
+
+void ProjectionCache::setDirectory(const std::string& directory)
+{
+    std::lock_guard< std::mutex > lock(m_mutex);
+    m_directory = directory;
+}
+
+void ProjectionCache::clear()
+{
+    std::lock_guard< std::mutex > lock(m_mutex);
+    m_entries.clear();
+    m_index.clear();
+    m_bytes = 0;
+}
+
+void ProjectionCache::insertLocked(const ProjectionKey& key, const Projection& projection)
+{
+    auto hash = key.hash();
+    auto it   = m_index.find(hash);
+    if (it != m_index.end())
+    {
+        m_bytes -= it->second->projection->size() * sizeof(float);
+        m_entries.erase(it->second);
+    }
+    m_entries.push_front({ key, projection });
+    m_index[hash] = m_entries.begin();
+    m_bytes += projection->size() * sizeof(float);
+    evictLocked();
+}
+
+void ProjectionCache::evictLocked()
+{
+    while (m_bytes > m_byteBudget && !m_entries.empty())
+    {
+        m_bytes -= m_entries.back().projection->size() * sizeof(float);
+        m_index.erase(m_entries.back().key.hash());
+        m_entries.pop_back();
+    }
+}
+
+auto ProjectionCache::filename(const ProjectionKey& key) const -> std::string
+{
+    return m_directory + "/" + QString::number(key.hash(), 16).rightJustified(16, '0').toStdString() + ".proj";
+}
+
+auto ProjectionCache::load(const ProjectionKey& key) const -> Projection
+{
+    std::string path;
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        if (m_directory.empty())
+        {
+            return nullptr;
+        }
+        path = filename(key);
+    }
+
+    QFile file(QString::fromStdString(path));
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return nullptr;
+    }
+    FileHeader header{};
+    auto expected = toHeader(key);
+    auto values   = static_cast< size_t >(key.width) * static_cast< size_t >(key.height);
+    if (file.read(reinterpret_cast< char* >(&header), sizeof(header)) != sizeof(header) ||
+        std::memcmp(&header, &expected, sizeof(header)) != 0 ||
+        file.size() != static_cast< qint64 >(sizeof(header) + values * sizeof(float)))
+    {
+        return nullptr;
+    }
+    auto projection = std::make_shared< std::vector< float > >(values);
+    if (file.read(reinterpret_cast< char* >(projection->data()), static_cast< qint64 >(values * sizeof(float))) !=
+        static_cast< qint64 >(values * sizeof(float)))
+    {
+        return nullptr;
+    }
+    return projection;
+}
+
+void ProjectionCache::store(const ProjectionKey& key, const std::vector< float >& projection) const
+{
+    std::string directory;
+    std::string path;
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        if (m_directory.empty())
+        {
+            return;
+        }
+        directory = m_directory;
+        path      = filename(key);
+    }
+    QDir().mkpath(QString::fromStdString(directory));
+
+    // Write to a temporary file first so that concurrent readers never see partial files
+    auto header = toHeader(key);
+    QString temporary(QString::fromStdString(path) + ".tmp" +
+                      QString::number(std::hash< std::thread::id >()(std::this_thread::get_id())));
+    QFile file(temporary);
+    if (!file.open(QIODevice::WriteOnly) ||
+        file.write(reinterpret_cast< const char* >(&header), sizeof(header)) != sizeof(header) ||
+        file.write(reinterpret_cast< const char* >(projection.data()),
+                   static_cast< qint64 >(projection.size() * sizeof(float))) !=
+            static_cast< qint64 >(projection.size() * sizeof(float)))
+    {
+        qWarning() << "Could not write projection cache file" << temporary;
+        file.remove();
+        return;
+    }
+    file.close();
+    QFile::remove(QString::fromStdString(path));
+    QFile::rename(temporary, QString::fromStdString(path));
+}
@@ -0,0 +1,76 @@
+/*
+ * ProjectionCache.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ForwardProjector.hpp"
+
+// Everything that determines a native projection
+struct ProjectionKey
+{
+    uint64_t volume = 0; // `contentHash` of the volume
+    std::array< double, 12 > matrix{};
+    int width               = 0;
+    int height              = 0;
+    double detectorSpacing  = 0.;
+    double volumeSpacing    = 0.;
+    int engine              = 0;
+    bool emptySpaceSkipping = false; // changes the sample positions of the packet engine
+
+    [[nodiscard]] auto hash() const -> uint64_t;
+    [[nodiscard]] auto operator==(const ProjectionKey& other) const -> bool;
+};
+
+// Hash of size and voxel values, independent of the memory layout
+auto contentHash(const VolumeView& volume) -> uint64_t;
+
+// Thread-safe LRU cache of projections with a byte budget. If a directory is set, projections are also stored there
+// (one file per key, never evicted) and loaded on misses of the in-memory cache.
+class ProjectionCache
+{
+  public:
+    using Projection = std::shared_ptr< const std::vector< float > >;
+
+    explicit ProjectionCache(size_t byteBudget = size_t(256) << 20, std::string directory = "");
+
+    // nullptr if not cached
+    auto find(const ProjectionKey& key) -> Projection;
+    void insert(const ProjectionKey& key, std::vector< float > projection);
+
+    void setByteBudget(size_t byteBudget);
+    void setDirectory(const std::string& directory);
+    void clear();
+
+  private:
+    struct Entry
+    {
+        ProjectionKey key;
+        Projection projection;
+    };
+
+    void insertLocked(const ProjectionKey& key, const Projection& projection);
+    void evictLocked();
+    [[nodiscard]] auto filename(const ProjectionKey& key) const -> std::string;
+    auto load(const ProjectionKey& key) const -> Projection;
+    void store(const ProjectionKey& key, const std::vector< float >& projection) const;
+
+    std::list< Entry > m_entries; // most recently used first
+    std::unordered_map< uint64_t, std::list< Entry >::iterator > m_index;
+    size_t m_bytes      = 0;
+    size_t m_byteBudget = 0;
+    std::string m_directory;
+    mutable std::mutex m_mutex;
+};
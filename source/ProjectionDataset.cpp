@@ -0,0 +1,200 @@
+/*
+ * ProjectionDataset.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "ProjectionDataset.hpp"
+
+#include <cstdint>
+#include <utility>
+
+namespace
+{
+constexpr double PROJECTION_LEVELS = 65535.;
+
+auto viewBytes(const cv::Mat& view) -> size_t
+{
+    return view.total() * view.elemSize();
+}
+} // namespace
+
+auto compactProjection(const cv::Mat& view, SampleFormat format) -> cv::Mat
+{
+    cv::Mat compact;
+    switch (format)
+    {
+    case SampleFormat::UInt16:
+        // Rounds and saturates
+        view.convertTo(compact, CV_16UC1, PROJECTION_LEVELS);
+        return compact;
+    case SampleFormat::Float16:
+        compact.create(view.rows, view.cols, CV_16UC1);
+        for (int row = 0; row < view.rows; ++row)
+        {
+            const auto* values = view.ptr< float >(row);
+            auto* halves       = compact.ptr< uint16_t >(row);
+            for (int col = 0; col < view.cols; ++col)
+            {
+                halves[col] = floatToHalf(values[col]);
+            }
+        }
+        return compact;
+    case SampleFormat::Float32:
+        break;
+    }
+    return view;
+}
+
+auto expandProjection(const cv::Mat& compact, SampleFormat format) -> cv::Mat
+{
+    cv::Mat view;
+    switch (format)
+    {
+    case SampleFormat::UInt16:
+        compact.convertTo(view, CV_32FC1, 1. / PROJECTION_LEVELS);
+        return view;
+    case SampleFormat::Float16:
+        view.create(compact.rows, compact.cols, CV_32FC1);
+        for (int row = 0; row < compact.rows; ++row)
+        {
+            const auto* halves = compact.ptr< uint16_t >(row);
+            auto* values       = view.ptr< float >(row);
+            for (int col = 0; col < compact.cols; ++col)
+            {
+                values[col] = halfToFloat(halves[col]);
+            }
+        }
+        return view;
+    case SampleFormat::Float32:
+        break;
+    }
+    return compact;
+}
+
+DecodedViewCache::DecodedViewCache(size_t byteBudget) : m_byteBudget(byteBudget)
+{
+}
+
+auto DecodedViewCache::find(const std::string& path) -> cv::Mat
+{
+    cv::Mat view;
+    SampleFormat format = SampleFormat::Float32;
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        auto it = m_index.find(path);
+        if (it == m_index.end())
+        {
+            return cv::Mat();
+        }
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        view   = it->second->view;
+        format = m_format;
+    }
+    return expandProjection(view, format);
+}
+
+void DecodedViewCache::insert(const std::string& path, const cv::Mat& view)
+{
+    SampleFormat format = SampleFormat::Float32;
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        format = m_format;
+    }
+    auto compact = compactProjection(view, format);
+
+    std::lock_guard< std::mutex > lock(m_mutex);
+    // Converted for a format that was replaced in the meantime
+    if (format != m_format)
+    {
+        return;
+    }
+    auto it = m_index.find(path);
+    if (it != m_index.end())
+    {
+        m_bytes -= viewBytes(it->second->view);
+        m_entries.erase(it->second);
+    }
+    m_entries.push_front({ path, compact });
+    m_index[path] = m_entries.begin();
+    m_bytes += viewBytes(compact);
+    evictLocked();
+}
+
+void DecodedViewCache::setByteBudget(size_t byteBudget)
+{
+    std::lock_guard< std::mutex > lock(m_mutex);
+    m_byteBudget = byteBudget;
+    evictLocked();
+}
+
+void DecodedViewCache::setFormat(SampleFormat format)
+{
+    std::lock_guard< std::mutex > lock(m_mutex);
+    if (format != m_format)
+    {
+        m_format = format;
+        clearLocked();
+    }
+}
+
+void DecodedViewCache::clear()
+{
+    std::lock_guard< std::mutex > lock(m_mutex);
+    clearLocked();
+}
+
+void DecodedViewCache::clearLocked()
+{
+    m_entries.clear();
+    m_index.clear();
+    m_bytes = 0;
+}
+
+void DecodedViewCache::evictLocked()
+{
+    // The most recent view is kept even if it exceeds the budget on its own
+    while (m_bytes > m_byteBudget && m_entries.size() > 1)
+    {
+        m_bytes -= viewBytes(m_entries.back().view);
+        m_index.erase(m_entries.back().path);
+        m_entries.pop_back();
+    }
+}
+
+ProjectionDataset::ProjectionDataset(std::vector< cv::Mat > views, std::vector< Geometry::ProjectionMatrix > matrices,
+                                     std::shared_ptr< const void > storage, SampleFormat format)
+    : m_views(std::move(views)), m_storage(std::move(storage)), m_matrices(std::move(matrices)), m_format(format)
+{
+}
+
+ProjectionDataset::ProjectionDataset(std::vector< std::string > files,
+                                     std::vector< Geometry::ProjectionMatrix > matrices, Decoder decoder,
+                                     bool concurrent, std::shared_ptr< DecodedViewCache > cache)
+    : m_files(std::move(files)), m_matrices(std::move(matrices)), m_decoder(std::move(decoder)),
+      m_concurrent(concurrent), m_cache(std::move(cache))
+{
+}
+
+auto ProjectionDataset::view(size_t i) const -> cv::Mat
+{
+    if (!lazy())
+    {
+        return expandProjection(m_views[i], m_format);
+    }
+    // Views may be decoded twice if two threads miss at the same time, which is cheaper than serializing all decodes
+    auto view = m_cache->find(m_files[i]);
+    if (!view.empty())
+    {
+        return view;
+    }
+    view = m_decoder(m_files[i]);
+    m_cache->insert(m_files[i], view);
+    return view;
+}
+
+auto ProjectionDataset::viewSize(size_t i) const -> cv::Size
+{
+    return lazy() ? view(i).size() : m_views[i].size();
+}
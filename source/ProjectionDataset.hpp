@@ -0,0 +1,99 @@
+/*
+ * ProjectionDataset.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <opencv2/core.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ProjectiveGeometry.hxx"
+#include "SampleFormat.hpp"
+
+// 16 bit copy (CV_16UC1) of a projection normalized to a maximum of 1. UInt16 uses a fixed scale of 1/65535 and clamps
+// negative values, Float16 stores the bits of half floats. Float32 views are returned as they are.
+auto compactProjection(const cv::Mat& view, SampleFormat format) -> cv::Mat;
+// CV_32FC1 projection from a `compactProjection`
+auto expandProjection(const cv::Mat& compact, SampleFormat format) -> cv::Mat;
+
+// Thread-safe LRU cache of decoded projections with a byte budget, shared by all lazy datasets. Views are stored in
+// `format` (see `compactProjection`).
+class DecodedViewCache
+{
+  public:
+    explicit DecodedViewCache(size_t byteBudget = 0);
+
+    // CV_32FC1, empty Mat if not cached
+    auto find(const std::string& path) -> cv::Mat;
+    // `view` is CV_32FC1 and normalized to a maximum of 1
+    void insert(const std::string& path, const cv::Mat& view);
+    void setByteBudget(size_t byteBudget);
+    // Drops all views if the format changes
+    void setFormat(SampleFormat format);
+    void clear();
+
+  private:
+    struct Entry
+    {
+        std::string path;
+        cv::Mat view;
+    };
+
+    void evictLocked();
+    void clearLocked();
+
+    std::list< Entry > m_entries; // most recently used first
+    std::unordered_map< std::string, std::list< Entry >::iterator > m_index;
+    size_t m_bytes        = 0;
+    size_t m_byteBudget   = 0;
+    SampleFormat m_format = SampleFormat::Float32;
+    std::mutex m_mutex;
+};
+
+// Projections and matrices of one pumpkin. Lazy datasets only know the files of their projections, views are decoded
+// on first use and kept in a `DecodedViewCache`. Views may be kept with 16 bit samples, `view` dequantizes them.
+class ProjectionDataset
+{
+  public:
+    using Decoder = std::function< cv::Mat(const std::string& path) >;
+
+    // All views already decoded (kept in memory), in `format` (see `compactProjection`). `storage` is kept alive if the
+    // views do not own their data.
+    ProjectionDataset(std::vector< cv::Mat > views, std::vector< Geometry::ProjectionMatrix > matrices,
+                      std::shared_ptr< const void > storage = nullptr, SampleFormat format = SampleFormat::Float32);
+    // `decoder` returns a CV_32FC1 projection normalized to a maximum of 1 and throws std::exception on errors. Unless
+    // it is `concurrent` it is only called on the thread that created the dataset. Decoded views are cached in the
+    // format of `cache`.
+    ProjectionDataset(std::vector< std::string > files, std::vector< Geometry::ProjectionMatrix > matrices,
+                      Decoder decoder, bool concurrent, std::shared_ptr< DecodedViewCache > cache);
+
+    [[nodiscard]] auto size() const -> size_t { return m_matrices.size(); }
+    [[nodiscard]] auto matrix(size_t i) const -> const Geometry::ProjectionMatrix& { return m_matrices[i]; }
+    [[nodiscard]] auto matrices() const -> const std::vector< Geometry::ProjectionMatrix >& { return m_matrices; }
+    [[nodiscard]] auto lazy() const -> bool { return m_views.empty(); }
+    // Whether `view` may be called from worker threads (e.g. round producers)
+    [[nodiscard]] auto concurrent() const -> bool { return m_concurrent; }
+    // Decodes view `i` if it is not cached. CV_32FC1, compact views are converted to a new Mat on each call.
+    [[nodiscard]] auto view(size_t i) const -> cv::Mat;
+    // Size of view `i`, only lazy datasets have to decode it
+    [[nodiscard]] auto viewSize(size_t i) const -> cv::Size;
+
+  private:
+    std::vector< cv::Mat > m_views;
+    std::shared_ptr< const void > m_storage;
+    std::vector< std::string > m_files;
+    std::vector< Geometry::ProjectionMatrix > m_matrices;
+    Decoder m_decoder;
+    bool m_concurrent = true;
+    std::shared_ptr< DecodedViewCache > m_cache;
+    SampleFormat m_format = SampleFormat::Float32; // of `m_views`
+};
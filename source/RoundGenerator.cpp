@@ -0,0 +1,125 @@
+/*
+ * RoundGenerator.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "RoundGenerator.hpp"
+
+#include <QDebug>
+#include <chrono>
+#include <exception>
+
+namespace
+{
+// A producer thread gives up after this many errors in a row, waiting a bit longer after each one (e.g. for a file
+// that is still written)
+constexpr int MAX_CONSECUTIVE_FAILURES = 3;
+constexpr std::chrono::milliseconds RETRY_DELAY(200);
+} // namespace
+
+RoundGenerator::~RoundGenerator() { stop(); }
+
+void RoundGenerator::start(Producer producer, int depth, int threads, std::mt19937& random)
+{
+    stop();
+    if (depth <= 0 || threads <= 0)
+    {
+        return;
+    }
+    m_producer = std::move(producer);
+    m_depth    = static_cast< size_t >(depth);
+    m_stopping = false;
+    m_cancelled.store(false);
+    for (int i = 0; i < threads; ++i)
+    {
+        m_threads.emplace_back(&RoundGenerator::produce, this, std::mt19937(random()));
+    }
+}
+
+void RoundGenerator::stop()
+{
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        m_stopping = true;
+        m_cancelled.store(true);
+    }
+    m_notFull.notify_all();
+    for (auto& thread : m_threads)
+    {
+        thread.join();
+    }
+    m_threads.clear();
+    m_rounds.clear();
+    m_inFlight      = 0;
+    m_failedThreads = 0;
+}
+
+auto RoundGenerator::failed() -> bool
+{
+    std::lock_guard< std::mutex > lock(m_mutex);
+    return !m_threads.empty() && m_failedThreads == m_threads.size();
+}
+
+auto RoundGenerator::tryPop() -> std::optional< PreparedRound >
+{
+    std::optional< PreparedRound > round;
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        if (m_rounds.empty())
+        {
+            return round;
+        }
+        round = std::move(m_rounds.front());
+        m_rounds.pop_front();
+    }
+    m_notFull.notify_one();
+    return round;
+}
+
+void RoundGenerator::produce(std::mt19937 random)
+{
+    int failures = 0;
+    std::unique_lock< std::mutex > lock(m_mutex);
+    while (true)
+    {
+        m_notFull.wait(lock, [this] { return m_stopping || m_rounds.size() + m_inFlight < m_depth; });
+        if (m_stopping)
+        {
+            return;
+        }
+        ++m_inFlight;
+        lock.unlock();
+
+        std::optional< PreparedRound > round;
+        try
+        {
+            round = m_producer(random, m_cancelled);
+        } catch (std::exception& exp)
+        {
+            qCritical() << "Could not prepare round!";
+            qCritical() << exp.what();
+        }
+
+        lock.lock();
+        --m_inFlight;
+        if (m_stopping)
+        {
+            return;
+        }
+        if (round)
+        {
+            failures = 0;
+            m_rounds.push_back(std::move(*round));
+            continue;
+        }
+        if (++failures == MAX_CONSECUTIVE_FAILURES)
+        {
+            qCritical() << "Stopped preparing rounds after" << failures << "errors in a row";
+            ++m_failedThreads;
+            return;
+        }
+        m_notFull.wait_for(lock, failures * RETRY_DELAY, [this] { return m_stopping; });
+    }
+}
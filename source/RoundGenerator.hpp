@@ -0,0 +1,82 @@
+/*
+ * RoundGenerator.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <opencv2/core.hpp>
+#include <optional>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "GameState.hpp"
+#include "ProjectiveGeometry.hxx"
+#include "SourceDetectorGeometry.h"
+
+// Everything `MainWindow` needs to show a new round. Views are plain cv::Mats so that rounds can be prepared without
+// touching Python objects.
+struct PreparedRound
+{
+    cv::Mat view1;
+    cv::Mat view2;
+    Geometry::ProjectionMatrix matrix1;
+    Geometry::ProjectionMatrix matrix2;
+    // `matrix1`/`matrix2` decomposed for `detectorSpacing`, for the epipolar lines and points
+    std::optional< Geometry::SourceDetectorGeometry > geometry1;
+    std::optional< Geometry::SourceDetectorGeometry > geometry2;
+    float detectorSpacing = 1.f;
+    Geometry::RP3Point randomPoint{};
+    EpipolarScreenLine compareLine{};
+    EpipolarScreenLine groundTruthLine{};
+};
+
+// Keeps a bounded queue of rounds prepared by producer threads while the current round is played
+class RoundGenerator
+{
+  public:
+    // Producers should pass `cancelled` on to long computations (e.g. `ProjectorOptions::cancelled`), the result of a
+    // cancelled call is discarded
+    using Producer = std::function< PreparedRound(std::mt19937& random, const std::atomic< bool >& cancelled) >;
+
+    RoundGenerator() = default;
+    ~RoundGenerator();
+    RoundGenerator(const RoundGenerator&) = delete;
+    RoundGenerator(RoundGenerator&&)      = delete;
+    auto operator=(const RoundGenerator&) -> RoundGenerator& = delete;
+    auto operator=(RoundGenerator &&) -> RoundGenerator& = delete;
+
+    // Discards all prepared rounds and runs `threads` producers until `depth` rounds are ready. `producer` must not use
+    // Python objects and has to be callable concurrently (each thread gets its own random generator).
+    void start(Producer producer, int depth, int threads, std::mt19937& random);
+    // Cancels rounds that are currently prepared, waits for the producers to return and discards everything
+    void stop();
+
+    [[nodiscard]] auto running() const -> bool { return !m_threads.empty(); }
+    // True once every producer thread gave up after repeated errors, `start` has to be called again
+    [[nodiscard]] auto failed() -> bool;
+    // Next prepared round if one is ready, never blocks
+    auto tryPop() -> std::optional< PreparedRound >;
+
+  private:
+    void produce(std::mt19937 random);
+
+    Producer m_producer;
+    std::deque< PreparedRound > m_rounds;
+    size_t m_depth    = 0;
+    size_t m_inFlight      = 0;
+    size_t m_failedThreads = 0;
+    bool m_stopping        = false;
+    std::atomic< bool > m_cancelled{ false };
+    std::mutex m_mutex;
+    std::condition_variable m_notFull;
+    std::vector< std::thread > m_threads;
+};
@@ -0,0 +1,55 @@
+/*
+ * SampleFormat.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Storage of volume samples and projection pixels. The 16 bit formats halve the memory and the bandwidth per sample,
+// they are dequantized when read.
+enum class SampleFormat : uint32_t {
+    Float32,
+    UInt16, // quantized: value = scale * sample + bias
+    Float16 // IEEE half precision, only finite values
+};
+
+// Half to single precision (exact). Infinities and NaNs are not supported.
+inline auto halfToFloat(uint16_t half) -> float
+{
+    // Exponent and mantissa moved to the single precision positions, multiplying with 2^(127 - 15) fixes the exponent
+    // bias and also converts subnormals
+    uint32_t bits = static_cast< uint32_t >(half & 0x7fffu) << 13;
+    float magnitude;
+    std::memcpy(&magnitude, &bits, sizeof(float));
+    magnitude *= 0x1.0p112f;
+    return (half & 0x8000u) ? -magnitude : magnitude;
+}
+
+// Single to half precision, rounded to nearest even. Values beyond the half range are clamped to +-65504.
+inline auto floatToHalf(float value) -> uint16_t
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(float));
+    auto sign = static_cast< uint16_t >((bits >> 16) & 0x8000u);
+    bits &= 0x7fffffffu;
+    if (bits >= 0x477ff000u) // rounds to infinity (or NaN)
+    {
+        return sign | 0x7bffu;
+    }
+    if (bits < 0x38800000u) // subnormal: multiples of 2^-24
+    {
+        float magnitude;
+        std::memcpy(&magnitude, &bits, sizeof(float));
+        return sign | static_cast< uint16_t >(std::nearbyint(magnitude * 0x1.0p24f));
+    }
+    // Rebias the exponent and round the 13 dropped mantissa bits to nearest even
+    uint32_t odd = (bits >> 13) & 1u;
+    bits += 0xc8000fffu + odd;
+    return sign | static_cast< uint16_t >(bits >> 13);
+}
@@ -0,0 +1,94 @@
+/*
+ * StreamingImport.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "StreamingImport.hpp"
+
+#include <QDebug>
+#include <QMetaObject>
+#include <exception>
+
+StreamingImport::StreamingImport(QObject* context) : m_context(context)
+{
+}
+
+StreamingImport::~StreamingImport()
+{
+    cancel();
+}
+
+void StreamingImport::start(std::function< void(StreamingImport& import) > work)
+{
+    cancel();
+    m_control = std::make_shared< Control >();
+    m_worker  = std::thread([this, work]() {
+        try
+        {
+            work(*this);
+        } catch (std::exception& exp)
+        {
+            qCritical() << "Import failed!";
+            qCritical() << exp.what();
+        }
+    });
+}
+
+void StreamingImport::cancel()
+{
+    {
+        std::lock_guard< std::mutex > lock(m_control->mutex);
+        m_control->cancelled = true;
+    }
+    m_control->consumed.notify_all();
+    if (m_worker.joinable())
+    {
+        m_worker.join();
+    }
+}
+
+void StreamingImport::post(std::function< void() > function)
+{
+    QMetaObject::invokeMethod(
+        m_context,
+        [control = m_control, function]() {
+            if (!control->cancelled)
+            {
+                function();
+            }
+        },
+        Qt::QueuedConnection);
+}
+
+auto StreamingImport::cancelled() const -> bool
+{
+    return m_control->cancelled;
+}
+
+auto StreamingImport::cancelFlag() const -> const std::atomic< bool >&
+{
+    return m_control->cancelled;
+}
+
+auto StreamingImport::acquire(size_t limit) -> bool
+{
+    std::unique_lock< std::mutex > lock(m_control->mutex);
+    m_control->consumed.wait(lock, [&]() { return m_control->cancelled || m_control->inFlight < limit; });
+    if (m_control->cancelled)
+    {
+        return false;
+    }
+    ++m_control->inFlight;
+    return true;
+}
+
+void StreamingImport::release()
+{
+    {
+        std::lock_guard< std::mutex > lock(m_control->mutex);
+        --m_control->inFlight;
+    }
+    m_control->consumed.notify_all();
+}
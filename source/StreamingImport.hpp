@@ -0,0 +1,57 @@
+/*
+ * StreamingImport.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <QObject>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Runs an import on a worker thread that hands each dataset to the GUI thread (`post`) as soon as it is ready, so
+// that the game can start with the first one. The worker must not touch Python objects, posted functions may.
+class StreamingImport
+{
+  public:
+    // Posted functions are run by the event loop of `context`
+    explicit StreamingImport(QObject* context);
+    ~StreamingImport();
+    StreamingImport(const StreamingImport&) = delete;
+    auto operator=(const StreamingImport&) -> StreamingImport& = delete;
+
+    // Cancels the running import and starts `work` on a new worker thread
+    void start(std::function< void(StreamingImport& import) > work);
+    // Stops the worker and drops all functions it posted that did not run yet. Only from the GUI thread.
+    void cancel();
+
+    // For the worker: runs `function` on the GUI thread unless the import is cancelled before
+    void post(std::function< void() > function);
+    [[nodiscard]] auto cancelled() const -> bool;
+    [[nodiscard]] auto cancelFlag() const -> const std::atomic< bool >&;
+    // For the worker: waits until less than `limit` acquired items are in flight, false if cancelled. Bounds the
+    // memory of data that is posted, but not consumed yet.
+    auto acquire(size_t limit) -> bool;
+    // For the posted functions: the item is consumed
+    void release();
+
+  private:
+    struct Control
+    {
+        std::atomic< bool > cancelled{ false };
+        std::mutex mutex;
+        std::condition_variable consumed;
+        size_t inFlight = 0;
+    };
+
+    QObject* m_context;
+    std::shared_ptr< Control > m_control = std::make_shared< Control >();
+    std::thread m_worker;
+};
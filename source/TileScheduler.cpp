@@ -0,0 +1,85 @@
+/*
+ * TileScheduler.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "TileScheduler.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+#ifdef _OPENMP
+#    include <omp.h>
+#endif
+
+namespace
+{
+std::atomic< int > activeSchedulers{ 0 };
+} // namespace
+
+TileScheduler::TileScheduler(const std::vector< int64_t >& order)
+{
+#ifdef _OPENMP
+    // Outside of the parallel region of `run`
+    m_maxThreads = omp_get_max_threads();
+#endif
+    activeSchedulers.fetch_add(1);
+    m_threads = std::max(1, std::min(threadShare(), static_cast< int >(order.size())));
+    m_queues  = std::make_unique< Queue[] >(m_threads);
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        m_queues[i % m_threads].tasks.push_back(order[i]);
+    }
+    for (int t = 0; t < m_threads; ++t)
+    {
+        m_queues[t].end = m_queues[t].tasks.size();
+    }
+}
+
+TileScheduler::~TileScheduler() { activeSchedulers.fetch_sub(1); }
+
+auto TileScheduler::next(int thread, int64_t& task) -> bool
+{
+    // Gives the threads above the share to schedulers that started later, thread 0 always stays
+    if (thread >= threadShare())
+    {
+        return false;
+    }
+    {
+        Queue& own = m_queues[thread];
+        std::lock_guard< std::mutex > lock(own.mutex);
+        if (own.begin < own.end)
+        {
+            task = own.tasks[own.begin++];
+            return true;
+        }
+    }
+    // No tasks are added during a run, so one pass over the other queues is enough
+    for (int offset = 1; offset < m_threads; ++offset)
+    {
+        Queue& victim = m_queues[(thread + offset) % m_threads];
+        std::lock_guard< std::mutex > lock(victim.mutex);
+        if (victim.begin < victim.end)
+        {
+            task = victim.tasks[--victim.end];
+            return true;
+        }
+    }
+    return false;
+}
+
+auto TileScheduler::threadShare() const -> int
+{
+    return std::max(1, m_maxThreads / std::max(1, activeSchedulers.load(std::memory_order_relaxed)));
+}
+
+auto TileScheduler::currentThread() -> int
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
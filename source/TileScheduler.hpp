@@ -0,0 +1,88 @@
+/*
+ * TileScheduler.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Work-stealing schedule of independent tasks (e.g. detector tiles) on the OpenMP threads. Tasks are dealt round-robin
+// into one queue per thread in the given order, so the most expensive ones should come first. Each thread works
+// through its own queue from the front and steals from the back of the other queues once it is empty.
+// Schedulers that run at the same time (round producers, the refinement, the preview) share the OpenMP threads: each
+// one starts with its share of `omp_get_max_threads()`, and threads above the share leave a run at the next task once
+// another scheduler was created. Their queues are stolen by the remaining threads.
+class TileScheduler
+{
+  public:
+    // `order` contains task ids in the order in which they should be started
+    explicit TileScheduler(const std::vector< int64_t >& order);
+    ~TileScheduler();
+    TileScheduler(const TileScheduler&) = delete;
+    TileScheduler(TileScheduler&&)      = delete;
+    auto operator=(const TileScheduler&) -> TileScheduler& = delete;
+    auto operator=(TileScheduler &&) -> TileScheduler& = delete;
+
+    // Calls `work(task, thread)` once for every task, `thread` < `threads()`. Can only be run once.
+    template< typename Work >
+    void run(Work work);
+
+    [[nodiscard]] auto threads() const -> int { return m_threads; }
+    // Per thread of the last run: time spent in `work` and time spent waiting for work (stealing, end of the run)
+    [[nodiscard]] auto busySeconds() const -> const std::vector< double >& { return m_busySeconds; }
+    [[nodiscard]] auto idleSeconds() const -> const std::vector< double >& { return m_idleSeconds; }
+
+  private:
+    struct alignas(64) Queue
+    {
+        std::mutex mutex;
+        std::vector< int64_t > tasks;
+        size_t begin = 0;
+        size_t end   = 0;
+    };
+
+    // Next task from the own queue or stolen from another one, false if all queues are empty
+    auto next(int thread, int64_t& task) -> bool;
+    static auto currentThread() -> int;
+    // Threads per scheduler if `m_maxThreads` are divided evenly between all existing schedulers, at least one
+    [[nodiscard]] auto threadShare() const -> int;
+
+    int m_maxThreads = 1;
+    int m_threads    = 1;
+    std::unique_ptr< Queue[] > m_queues;
+    std::vector< double > m_busySeconds;
+    std::vector< double > m_idleSeconds;
+};
+
+template< typename Work >
+void TileScheduler::run(Work work)
+{
+    using Clock = std::chrono::steady_clock;
+    m_busySeconds.assign(m_threads, 0.);
+    m_idleSeconds.assign(m_threads, 0.);
+
+#pragma omp parallel num_threads(m_threads)
+    {
+        int thread   = currentThread();
+        auto start   = Clock::now();
+        double busy  = 0.;
+        int64_t task = 0;
+        while (next(thread, task))
+        {
+            auto begin = Clock::now();
+            work(task, thread);
+            busy += std::chrono::duration< double >(Clock::now() - begin).count();
+        }
+        // Waiting for the others is idle time as well
+#pragma omp barrier
+        m_busySeconds[thread] = busy;
+        m_idleSeconds[thread] = std::chrono::duration< double >(Clock::now() - start).count() - busy;
+    }
+}
@@ -0,0 +1,648 @@
+/*
+ * VolumeLoader.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "VolumeLoader.hpp"
+
+#include <QDebug>
+#include <QFileInfo>
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <new>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#include "MappedVolume.hpp"
+#include "ParallelImport.hpp"
+
+#ifdef _OPENMP
+#    include <omp.h>
+#endif
+
+namespace
+{
+constexpr size_t ALIGNMENT = 64;
+
+enum class SampleType { UInt8, Int8, UInt16, Int16, UInt32, Int32, Float32, Float64 };
+
+auto sampleBytes(SampleType type) -> int
+{
+    switch (type)
+    {
+    case SampleType::UInt8:
+    case SampleType::Int8:
+        return 1;
+    case SampleType::UInt16:
+    case SampleType::Int16:
+        return 2;
+    case SampleType::UInt32:
+    case SampleType::Int32:
+    case SampleType::Float32:
+        return 4;
+    case SampleType::Float64:
+        return 8;
+    }
+    return 0;
+}
+
+auto hostIsBigEndian() -> bool
+{
+    const uint16_t one = 1;
+    unsigned char first;
+    std::memcpy(&first, &one, 1);
+    return first == 0;
+}
+
+template< typename T >
+void convert(const char* source, float* destination, size_t count, bool swapBytes)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, source + i * sizeof(T), sizeof(T));
+        if (swapBytes)
+        {
+            std::reverse(bytes, bytes + sizeof(T));
+        }
+        T value;
+        std::memcpy(&value, bytes, sizeof(T));
+        destination[i] = static_cast< float >(value);
+    }
+}
+
+void convertSamples(const char* source, float* destination, size_t count, SampleType type, bool swapBytes)
+{
+    switch (type)
+    {
+    case SampleType::UInt8:
+        return convert< uint8_t >(source, destination, count, false);
+    case SampleType::Int8:
+        return convert< int8_t >(source, destination, count, false);
+    case SampleType::UInt16:
+        return convert< uint16_t >(source, destination, count, swapBytes);
+    case SampleType::Int16:
+        return convert< int16_t >(source, destination, count, swapBytes);
+    case SampleType::UInt32:
+        return convert< uint32_t >(source, destination, count, swapBytes);
+    case SampleType::Int32:
+        return convert< int32_t >(source, destination, count, swapBytes);
+    case SampleType::Float32:
+        return convert< float >(source, destination, count, swapBytes);
+    case SampleType::Float64:
+        return convert< double >(source, destination, count, swapBytes);
+    }
+}
+
+void readBytes(std::ifstream& file, uint64_t offset, size_t size, std::vector< char >& buffer)
+{
+    buffer.resize(size);
+    file.seekg(static_cast< std::streamoff >(offset));
+    file.read(buffer.data(), static_cast< std::streamsize >(size));
+    if (!file || static_cast< size_t >(file.gcount()) != size)
+    {
+        throw std::runtime_error("Unexpected end of file");
+    }
+}
+
+// Calls `decode(file, slice, buffer)` for all slices in parallel, every thread with its own file handle and buffer.
+// `concurrentFiles` calls at the same time share the OpenMP threads. The first exception is rethrown after all threads
+// have finished.
+template< typename Decode >
+void decodeSlices(const std::string& path, int64_t slices, int concurrentFiles, Decode decode)
+{
+    int threads = 1;
+#ifdef _OPENMP
+    threads = std::max(1, omp_get_max_threads() / std::max(1, concurrentFiles));
+#endif
+    std::exception_ptr error;
+#pragma omp parallel num_threads(threads)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::vector< char > buffer;
+#pragma omp for schedule(dynamic)
+        for (int64_t slice = 0; slice < slices; ++slice)
+        {
+            try
+            {
+                if (!file.is_open())
+                {
+                    throw std::runtime_error("Could not open " + path);
+                }
+                decode(file, slice, buffer);
+            } catch (...)
+            {
+#pragma omp critical
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+            }
+        }
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+// Directory of a TIFF file with everything needed to decode one page
+struct TiffPage
+{
+    int64_t width        = 0;
+    int64_t height       = 0;
+    int64_t rowsPerStrip = 0;
+    SampleType type      = SampleType::UInt8;
+    std::vector< uint64_t > stripOffsets;
+    std::vector< uint64_t > stripByteCounts;
+};
+
+class TiffParser
+{
+  public:
+    explicit TiffParser(const std::string& path) : m_file(path, std::ios::binary)
+    {
+        if (!m_file.is_open())
+        {
+            throw std::runtime_error("Could not open " + path);
+        }
+        readBytes(m_file, 0, 8, m_buffer);
+        if (std::memcmp(m_buffer.data(), "II", 2) != 0 && std::memcmp(m_buffer.data(), "MM", 2) != 0)
+        {
+            throw std::runtime_error("Not a TIFF file");
+        }
+        m_littleEndian = m_buffer[0] == 'I';
+        auto version   = integer(m_buffer.data() + 2, 2);
+        if (version == 43)
+        {
+            m_bigTiff = true;
+            readBytes(m_file, 8, 8, m_buffer);
+            m_nextDirectory = integer(m_buffer.data(), 8);
+        }
+        else if (version == 42)
+        {
+            m_nextDirectory = integer(m_buffer.data() + 4, 4);
+        }
+        else
+        {
+            throw std::runtime_error("Not a TIFF file");
+        }
+    }
+
+    [[nodiscard]] auto swapBytes() const -> bool { return m_littleEndian == hostIsBigEndian(); }
+
+    auto pages() -> std::vector< TiffPage >
+    {
+        std::vector< TiffPage > pages;
+        std::set< uint64_t > visited;
+        while (m_nextDirectory != 0)
+        {
+            if (!visited.insert(m_nextDirectory).second)
+            {
+                throw std::runtime_error("Cyclic image file directories");
+            }
+            pages.push_back(readDirectory());
+        }
+        return pages;
+    }
+
+  private:
+    [[nodiscard]] auto integer(const char* bytes, int size) const -> uint64_t
+    {
+        unsigned char value[8] = {};
+        std::memcpy(value, bytes, size);
+        uint64_t result = 0;
+        for (int b = 0; b < size; ++b)
+        {
+            result |= static_cast< uint64_t >(value[m_littleEndian ? b : size - 1 - b]) << (8 * b);
+        }
+        return result;
+    }
+
+    // Integer values of a directory entry (BYTE, SHORT, LONG, LONG8 and IFD types)
+    auto values(const char* entry) -> std::vector< uint64_t >
+    {
+        int inlineSize         = m_bigTiff ? 8 : 4;
+        auto type              = integer(entry + 2, 2);
+        auto count             = integer(entry + 4, m_bigTiff ? 8 : 4);
+        const char* valueField = entry + (m_bigTiff ? 12 : 8);
+
+        int size = 0;
+        switch (type)
+        {
+        case 1:
+            size = 1;
+            break;
+        case 3:
+            size = 2;
+            break;
+        case 4:
+        case 13:
+            size = 4;
+            break;
+        case 16:
+        case 18:
+            size = 8;
+            break;
+        default:
+            throw std::runtime_error("Unsupported TIFF field type " + std::to_string(type));
+        }
+        if (count > (uint64_t(1) << 32))
+        {
+            throw std::runtime_error("Broken TIFF field");
+        }
+
+        std::vector< char > outOfLine;
+        const char* data = valueField;
+        if (count * size > static_cast< uint64_t >(inlineSize))
+        {
+            readBytes(m_file, integer(valueField, inlineSize), count * size, outOfLine);
+            data = outOfLine.data();
+        }
+        std::vector< uint64_t > result(count);
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            result[i] = integer(data + i * size, size);
+        }
+        return result;
+    }
+
+    auto readDirectory() -> TiffPage
+    {
+        int countSize = m_bigTiff ? 8 : 2;
+        int entrySize = m_bigTiff ? 20 : 12;
+        int nextSize  = m_bigTiff ? 8 : 4;
+        readBytes(m_file, m_nextDirectory, countSize, m_buffer);
+        auto entries = integer(m_buffer.data(), countSize);
+        readBytes(m_file, m_nextDirectory + countSize, entries * entrySize + nextSize, m_buffer);
+        std::vector< char > directory = m_buffer;
+        m_nextDirectory               = integer(directory.data() + entries * entrySize, nextSize);
+
+        TiffPage page;
+        uint64_t bitsPerSample = 1;
+        uint64_t sampleFormat  = 1;
+        for (uint64_t e = 0; e < entries; ++e)
+        {
+            const char* entry = directory.data() + e * entrySize;
+            auto tag          = integer(entry, 2);
+            switch (tag)
+            {
+            case 256:
+                page.width = static_cast< int64_t >(values(entry).at(0));
+                break;
+            case 257:
+                page.height = static_cast< int64_t >(values(entry).at(0));
+                break;
+            case 258:
+                bitsPerSample = values(entry).at(0);
+                break;
+            case 259:
+                if (values(entry).at(0) != 1)
+                {
+                    throw std::runtime_error("Compressed TIFF");
+                }
+                break;
+            case 273:
+                page.stripOffsets = values(entry);
+                break;
+            case 277:
+                if (values(entry).at(0) != 1)
+                {
+                    throw std::runtime_error("TIFF with more than one sample per pixel");
+                }
+                break;
+            case 278:
+                page.rowsPerStrip = static_cast< int64_t >(values(entry).at(0));
+                break;
+            case 279:
+                page.stripByteCounts = values(entry);
+                break;
+            case 322:
+                throw std::runtime_error("Tiled TIFF");
+            case 339:
+                sampleFormat = values(entry).at(0);
+                break;
+            default:
+                break;
+            }
+        }
+
+        static const std::map< std::pair< uint64_t, uint64_t >, SampleType > types{
+            { { 1, 8 }, SampleType::UInt8 },   { { 2, 8 }, SampleType::Int8 },
+            { { 1, 16 }, SampleType::UInt16 }, { { 2, 16 }, SampleType::Int16 },
+            { { 1, 32 }, SampleType::UInt32 }, { { 2, 32 }, SampleType::Int32 },
+            { { 3, 32 }, SampleType::Float32 }, { { 3, 64 }, SampleType::Float64 },
+        };
+        auto type = types.find({ sampleFormat, bitsPerSample });
+        if (type == types.end())
+        {
+            throw std::runtime_error("Unsupported TIFF sample format");
+        }
+        page.type = type->second;
+        if (page.rowsPerStrip <= 0 || page.rowsPerStrip > page.height)
+        {
+            page.rowsPerStrip = page.height;
+        }
+        auto strips = page.height > 0 ? (page.height + page.rowsPerStrip - 1) / page.rowsPerStrip : 0;
+        if (page.width <= 0 || page.height <= 0 || page.stripOffsets.size() != static_cast< size_t >(strips))
+        {
+            throw std::runtime_error("Broken TIFF directory");
+        }
+        return page;
+    }
+
+    std::ifstream m_file;
+    std::vector< char > m_buffer;
+    bool m_littleEndian      = true;
+    bool m_bigTiff           = false;
+    uint64_t m_nextDirectory = 0;
+};
+
+auto lower(const QString& string) -> std::string
+{
+    return string.toLower().toStdString();
+}
+} // namespace
+
+void AlignedDelete::operator()(float* data) const
+{
+    ::operator delete[](data, std::align_val_t(ALIGNMENT));
+}
+
+auto allocateAlignedFloats(size_t count) -> AlignedFloats
+{
+    return AlignedFloats(static_cast< float* >(::operator new[](count * sizeof(float), std::align_val_t(ALIGNMENT))));
+}
+
+auto loadTiffVolume(const std::string& path, int concurrentFiles) -> LoadedVolume
+{
+    TiffParser parser(path);
+    auto pages = parser.pages();
+    if (pages.empty())
+    {
+        throw std::runtime_error("TIFF without images");
+    }
+    const TiffPage& first = pages.front();
+    for (auto& page : pages)
+    {
+        if (page.width != first.width || page.height != first.height || page.type != first.type)
+        {
+            throw std::runtime_error("TIFF pages of different size or type");
+        }
+    }
+
+    LoadedVolume volume;
+    volume.path     = path;
+    volume.size     = { static_cast< int64_t >(pages.size()), first.height, first.width };
+    auto pageSize   = static_cast< size_t >(first.width * first.height);
+    volume.data     = allocateAlignedFloats(pageSize * pages.size());
+    auto sampleSize = sampleBytes(first.type);
+    bool swap       = parser.swapBytes();
+
+    auto decodePage = [&](std::ifstream& file, int64_t p, std::vector< char >& buffer) {
+        const TiffPage& page = pages[p];
+        for (size_t s = 0; s < page.stripOffsets.size(); ++s)
+        {
+            auto row  = static_cast< int64_t >(s) * page.rowsPerStrip;
+            auto rows = std::min(page.rowsPerStrip, page.height - row);
+            auto size = static_cast< size_t >(rows * page.width);
+            readBytes(file, page.stripOffsets[s], size * sampleSize, buffer);
+            convertSamples(buffer.data(), volume.data.get() + p * pageSize + row * page.width, size, page.type, swap);
+        }
+    };
+    decodeSlices(path, volume.size[0], concurrentFiles, decodePage);
+    return volume;
+}
+
+auto loadMetaImageVolume(const std::string& path, int concurrentFiles) -> LoadedVolume
+{
+    std::ifstream header(path, std::ios::binary);
+    if (!header.is_open())
+    {
+        throw std::runtime_error("Could not open " + path);
+    }
+
+    // "Key = Value" lines, ElementDataFile is the last one
+    std::map< std::string, std::string > fields;
+    std::string line;
+    while (std::getline(header, line))
+    {
+        auto separator = line.find('=');
+        if (separator == std::string::npos)
+        {
+            continue;
+        }
+        auto trim = [](std::string string) {
+            string.erase(0, string.find_first_not_of(" \t\r"));
+            string.erase(string.find_last_not_of(" \t\r") + 1);
+            return string;
+        };
+        auto key    = trim(line.substr(0, separator));
+        fields[key] = trim(line.substr(separator + 1));
+        if (key == "ElementDataFile")
+        {
+            break;
+        }
+    }
+    auto field = [&fields](const std::string& key, const std::string& fallback = "") {
+        auto found = fields.find(key);
+        return found == fields.end() ? fallback : found->second;
+    };
+
+    static const std::map< std::string, SampleType > types{
+        { "MET_UCHAR", SampleType::UInt8 },  { "MET_CHAR", SampleType::Int8 },   { "MET_USHORT", SampleType::UInt16 },
+        { "MET_SHORT", SampleType::Int16 },  { "MET_UINT", SampleType::UInt32 }, { "MET_INT", SampleType::Int32 },
+        { "MET_FLOAT", SampleType::Float32 }, { "MET_DOUBLE", SampleType::Float64 },
+    };
+    auto type = types.find(field("ElementType"));
+    if (field("NDims") != "3" || type == types.end() || field("ElementNumberOfChannels", "1") != "1")
+    {
+        throw std::runtime_error("Unsupported MetaImage type");
+    }
+    if (field("CompressedData", "False") != "False")
+    {
+        throw std::runtime_error("Compressed MetaImage");
+    }
+    std::istringstream dimensions(field("DimSize"));
+    std::array< int64_t, 3 > dimSize{};
+    if (!(dimensions >> dimSize[0] >> dimSize[1] >> dimSize[2]) ||
+        *std::min_element(dimSize.begin(), dimSize.end()) <= 0)
+    {
+        throw std::runtime_error("Broken MetaImage dimensions");
+    }
+    bool bigEndian = field("BinaryDataByteOrderMSB", field("ElementByteOrderMSB", field("ByteOrderMSB", "False"))) ==
+                     "True";
+
+    auto dataFile   = field("ElementDataFile");
+    uint64_t offset = 0;
+    std::string dataPath;
+    if (dataFile == "LOCAL")
+    {
+        dataPath = path;
+        offset   = static_cast< uint64_t >(header.tellg());
+    }
+    else if (!dataFile.empty() && dataFile != "LIST" && dataFile.find('%') == std::string::npos)
+    {
+        dataPath = QFileInfo(QFileInfo(QString::fromStdString(path)).dir(), QString::fromStdString(dataFile))
+                       .filePath()
+                       .toStdString();
+    }
+    else
+    {
+        throw std::runtime_error("Unsupported MetaImage data file");
+    }
+
+    LoadedVolume volume;
+    volume.path     = path;
+    volume.dataFile = dataPath == path ? "" : dataPath;
+    volume.size     = { dimSize[2], dimSize[1], dimSize[0] };
+    auto sliceSize  = static_cast< size_t >(dimSize[0] * dimSize[1]);
+    auto sliceBytes = sliceSize * sampleBytes(type->second);
+    auto headerSize = std::stoll(field("HeaderSize", "0"));
+    if (headerSize == -1)
+    {
+        // Data at the end of the file
+        std::ifstream data(dataPath, std::ios::binary | std::ios::ate);
+        auto fileSize = static_cast< int64_t >(data.tellg());
+        auto dataSize = static_cast< int64_t >(sliceBytes) * volume.size[0];
+        if (fileSize < dataSize)
+        {
+            throw std::runtime_error("MetaImage data file too small");
+        }
+        offset = static_cast< uint64_t >(fileSize - dataSize);
+    }
+    else
+    {
+        offset += static_cast< uint64_t >(std::max(headerSize, 0LL));
+    }
+    volume.data = allocateAlignedFloats(sliceSize * volume.size[0]);
+    bool swap   = bigEndian != hostIsBigEndian();
+
+    auto decodeSlice = [&](std::ifstream& file, int64_t z, std::vector< char >& buffer) {
+        readBytes(file, offset + z * sliceBytes, sliceBytes, buffer);
+        convertSamples(buffer.data(), volume.data.get() + z * sliceSize, sliceSize, type->second, swap);
+    };
+    decodeSlices(dataPath, volume.size[0], concurrentFiles, decodeSlice);
+    return volume;
+}
+
+auto loadMappedVolume(const std::string& path) -> LoadedVolume
+{
+    LoadedVolume volume;
+    volume.path   = path;
+    volume.mapped = std::make_shared< const MappedVolume >(path);
+    volume.size   = volume.mapped->size();
+    return volume;
+}
+
+auto streamVolumesNative(const std::string& dirname, int concurrency,
+                         const std::function< void(LoadedVolume volume) >& onVolume,
+                         const std::function< void(size_t done, size_t total) >& onProgress,
+                         const std::atomic< bool >* cancelled) -> NativeVolumes
+{
+    std::vector< std::string > files;
+    for (auto& directory : scanDirectoryTree(dirname, concurrency))
+    {
+        for (auto& name : directory.files)
+        {
+            files.push_back(directory.path + "/" + name);
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    std::vector< std::string > candidates;
+    for (auto& file : files)
+    {
+        auto suffix = lower(QFileInfo(QString::fromStdString(file)).suffix());
+        if (suffix == "tif" || suffix == "tiff" || suffix == "epivol" || suffix == "mhd" || suffix == "mha")
+        {
+            candidates.push_back(file);
+        }
+    }
+    if (onProgress)
+    {
+        onProgress(0, candidates.size());
+    }
+
+    // Files are decoded concurrently (each one still with parallel slices on its share of the OpenMP threads), so
+    // that many reads are in flight without oversubscribing the cores
+    auto concurrentFiles = static_cast< int >(std::min< size_t >(std::max(concurrency, 1), candidates.size()));
+    std::mutex mutex;
+    std::set< std::string > handled;
+    std::atomic< size_t > done{ 0 };
+    parallelFor(candidates.size(), concurrency, [&](size_t i) {
+        if (cancelled && *cancelled)
+        {
+            return;
+        }
+        auto& file  = candidates[i];
+        auto suffix = lower(QFileInfo(QString::fromStdString(file)).suffix());
+        try
+        {
+            LoadedVolume volume;
+            if (suffix == "epivol")
+            {
+                volume = loadMappedVolume(file);
+            }
+            else if (suffix == "tif" || suffix == "tiff")
+            {
+                volume = loadTiffVolume(file, concurrentFiles);
+            }
+            else
+            {
+                volume = loadMetaImageVolume(file, concurrentFiles);
+            }
+            {
+                std::lock_guard< std::mutex > lock(mutex);
+                if (!volume.dataFile.empty())
+                {
+                    handled.insert(
+                        QFileInfo(QString::fromStdString(volume.dataFile)).absoluteFilePath().toStdString());
+                }
+                handled.insert(QFileInfo(QString::fromStdString(file)).absoluteFilePath().toStdString());
+            }
+            if (volume.size[0] > 1)
+            {
+                qInfo() << "Loaded" << QString::fromStdString(file) << "natively:" << volume.size[0] << "x"
+                        << volume.size[1] << "x" << volume.size[2];
+                onVolume(std::move(volume));
+            }
+        } catch (std::exception& exp)
+        {
+            qDebug() << "Native loader skips" << QString::fromStdString(file) << ":" << exp.what();
+        }
+        if (onProgress)
+        {
+            onProgress(++done, candidates.size());
+        }
+    });
+
+    NativeVolumes result;
+    for (auto& file : files)
+    {
+        auto absolute = QFileInfo(QString::fromStdString(file)).absoluteFilePath().toStdString();
+        (handled.count(absolute) ? result.handledFiles : result.unhandledFiles).push_back(absolute);
+    }
+    return result;
+}
+
+auto loadVolumesNative(const std::string& dirname, int concurrency) -> NativeVolumes
+{
+    std::mutex mutex;
+    std::vector< LoadedVolume > volumes;
+    auto result = streamVolumesNative(dirname, concurrency, [&](LoadedVolume volume) {
+        std::lock_guard< std::mutex > lock(mutex);
+        volumes.push_back(std::move(volume));
+    });
+    std::sort(volumes.begin(), volumes.end(),
+              [](const LoadedVolume& a, const LoadedVolume& b) { return a.path < b.path; });
+    result.volumes = std::move(volumes);
+    return result;
+}
@@ -0,0 +1,68 @@
+/*
+ * VolumeLoader.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ParallelImport.hpp"
+
+class MappedVolume;
+
+struct AlignedDelete
+{
+    void operator()(float* data) const;
+};
+// Float buffer aligned to 64 bytes (cache line/AVX-512 vector)
+using AlignedFloats = std::unique_ptr< float[], AlignedDelete >;
+auto allocateAlignedFloats(size_t count) -> AlignedFloats;
+
+// Volume decoded by a native loader, C-contiguous with the slices (TIFF pages, MetaImage z) along the first axis like
+// the arrays of `epipolar.read_volumes`. Mapped volumes (.epivol) have no `data` but `mapped`.
+struct LoadedVolume
+{
+    std::string path;
+    std::string dataFile; // separate file with the samples (MetaImage), empty if none
+    std::array< int64_t, 3 > size{};
+    AlignedFloats data;
+    std::shared_ptr< const MappedVolume > mapped;
+};
+
+// Uncompressed multi-page TIFF (classic and BigTIFF, one 8 to 64 bit integer or float sample per pixel, stored in
+// strips). Pages are decoded in parallel on the OpenMP threads divided by `concurrentFiles`, the number of files that
+// are decoded at the same time. Throws std::runtime_error for unsupported or broken files.
+auto loadTiffVolume(const std::string& path, int concurrentFiles = 1) -> LoadedVolume;
+// Uncompressed MetaImage: .mhd header with a separate raw file or .mha with the data appended. Slices are read in
+// parallel like the pages of `loadTiffVolume`. Throws std::runtime_error for unsupported or broken files.
+auto loadMetaImageVolume(const std::string& path, int concurrentFiles = 1) -> LoadedVolume;
+// Maps a .epivol file (see MappedVolume) without reading the samples
+auto loadMappedVolume(const std::string& path) -> LoadedVolume;
+
+struct NativeVolumes
+{
+    std::vector< LoadedVolume > volumes; // sorted by path
+    std::vector< std::string > handledFiles;
+    std::vector< std::string > unhandledFiles; // other formats, compressed TIFFs, ...
+};
+
+// Reads all TIFF and MetaImage volumes in `dirname` and its subdirectories and maps all .epivol files (see
+// MappedVolume). Single-page TIFFs are handled, but no volumes. Raw files referenced by a MetaImage header count as
+// handled. Up to `concurrency` files are read at the same time.
+auto loadVolumesNative(const std::string& dirname, int concurrency = DEFAULT_IO_CONCURRENCY) -> NativeVolumes;
+// Like `loadVolumesNative`, but each volume is passed to `onVolume` as soon as it is decoded (on a worker thread, in no
+// particular order) instead of being returned. `onProgress` counts the files that were tried. Stops starting new files
+// once `cancelled` is set.
+auto streamVolumesNative(const std::string& dirname, int concurrency,
+                         const std::function< void(LoadedVolume volume) >& onVolume,
+                         const std::function< void(size_t done, size_t total) >& onProgress = nullptr,
+                         const std::atomic< bool >* cancelled = nullptr) -> NativeVolumes;
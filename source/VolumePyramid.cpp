@@ -0,0 +1,105 @@
+/*
+ * VolumePyramid.cpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#include "VolumePyramid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+struct Tap
+{
+    int64_t index;
+    float weight;
+};
+
+// Tent filter of width 2 (in fine voxels) around the centers of the coarse voxels. The fine volume is zero outside,
+// weights are normalized over the full filter so that line integrals are preserved.
+auto downsamplingTaps(int64_t fineSize, int64_t coarseSize) -> std::vector< std::vector< Tap > >
+{
+    std::vector< std::vector< Tap > > taps(static_cast< size_t >(coarseSize));
+    for (int64_t i = 0; i < coarseSize; ++i)
+    {
+        // World position (i - coarseSize / 2) * 2 in fine index coordinates
+        double center = 2. * static_cast< double >(i) - static_cast< double >(coarseSize) + 0.5 * fineSize;
+        double total  = 0.;
+        for (auto j = static_cast< int64_t >(std::ceil(center - 2.)); j <= static_cast< int64_t >(center + 2.); ++j)
+        {
+            double weight = 1. - std::abs(static_cast< double >(j) - center) / 2.;
+            if (weight <= 0.)
+            {
+                continue;
+            }
+            total += weight;
+            if (j >= 0 && j < fineSize)
+            {
+                taps[i].push_back({ j, static_cast< float >(weight) });
+            }
+        }
+        for (auto& tap : taps[i])
+        {
+            tap.weight /= static_cast< float >(total);
+        }
+    }
+    return taps;
+}
+} // namespace
+
+VolumePyramid::VolumePyramid(const VolumeView& volume, int minSize)
+{
+    VolumeView fine = volume;
+    while (std::min({ fine.size[0], fine.size[1], fine.size[2] }) / 2 >= minSize)
+    {
+        Level coarse;
+        for (int a = 0; a < 3; ++a)
+        {
+            coarse.size[a] = (fine.size[a] + 1) / 2;
+        }
+        std::array< std::vector< std::vector< Tap > >, 3 > taps{ downsamplingTaps(fine.size[0], coarse.size[0]),
+                                                                 downsamplingTaps(fine.size[1], coarse.size[1]),
+                                                                 downsamplingTaps(fine.size[2], coarse.size[2]) };
+        coarse.data.assign(static_cast< size_t >(coarse.size[0] * coarse.size[1] * coarse.size[2]), 0.f);
+
+#pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < coarse.size[0]; ++i)
+        {
+            for (int64_t j = 0; j < coarse.size[1]; ++j)
+            {
+                for (int64_t k = 0; k < coarse.size[2]; ++k)
+                {
+                    float sum = 0.f;
+                    for (auto& ti : taps[0][i])
+                    {
+                        for (auto& tj : taps[1][j])
+                        {
+                            for (auto& tk : taps[2][k])
+                            {
+                                sum += ti.weight * tj.weight * tk.weight * fine.at(ti.index, tj.index, tk.index);
+                            }
+                        }
+                    }
+                    coarse.data[static_cast< size_t >((i * coarse.size[1] + j) * coarse.size[2] + k)] = sum;
+                }
+            }
+        }
+
+        m_levels.push_back(std::move(coarse));
+        fine = level(levels());
+    }
+}
+
+auto VolumePyramid::level(int l) const -> VolumeView
+{
+    const Level& level = m_levels[static_cast< size_t >(l - 1)];
+    VolumeView view;
+    view.data    = level.data.data();
+    view.size    = level.size;
+    view.stride  = { level.size[1] * level.size[2], level.size[2], 1 };
+    view.spacing = std::ldexp(1., l);
+    return view;
+}
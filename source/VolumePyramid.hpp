@@ -0,0 +1,39 @@
+/*
+ * VolumePyramid.hpp
+ * Copyright (C) 2019 Stephan Seitz <stephan.seitz@fau.de>
+ *
+ * Distributed under terms of the GPLv3 license.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "ForwardProjector.hpp"
+
+// Mip levels of a volume, each with half the resolution of the previous one. Level l has a voxel spacing of 2^l
+// (relative to the original volume) and covers the same world region: its voxels are tent-filtered from the finer level
+// at the positions of their centers, so projections of all levels line up.
+//
+// Level 0 is the original volume and is not stored.
+class VolumePyramid
+{
+  public:
+    VolumePyramid() = default;
+    // Downsamples until the smallest axis would get shorter than `minSize` voxels
+    explicit VolumePyramid(const VolumeView& volume, int minSize = 16);
+
+    [[nodiscard]] auto levels() const -> int { return static_cast< int >(m_levels.size()); }
+    // Level in [1, levels()], only valid as long as this object exists
+    [[nodiscard]] auto level(int l) const -> VolumeView;
+
+  private:
+    struct Level
+    {
+        std::vector< float > data;
+        std::array< int64_t, 3 > size{};
+    };
+    std::vector< Level > m_levels;
+};
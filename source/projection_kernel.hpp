@@ -1,6 +1,16 @@
+#pragma once
+
+#include <cstdint>
 
 #include "python_include.hpp"
 
+void projection_kernel(float T0, float T1, float T10, float T11, float T2, float T3, float T4, float T5, float T6,
+                       float T7, float T8, float T9, float* _data_proj, float* _data_vol, int64_t const _size_proj_0,
+                       int64_t const _size_proj_1, int64_t const _size_vol_0, int64_t const _size_vol_1,
+                       int64_t const _size_vol_2, int64_t const _stride_proj_0, int64_t const _stride_proj_1,
+                       int64_t const _stride_vol_0, int64_t const _stride_vol_1, int64_t const _stride_vol_2,
+                       double detector_spacing, double volume_spacing);
+
 void call_projection_kernel(float T0, float T1, float T2, float T3, float T4, float T5, float T6, float T7, float T8,
                             float T9, float T10, float T11, double detector_spacing, pybind11::array_t< float > proj,
                             pybind11::array_t< float > vol, double volume_spacing);